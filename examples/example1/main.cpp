@@ -171,7 +171,11 @@ public:
       jgfx::PipelineDesc{
         .program = program,
         .vertexAttributes = attr,
-        .cullMode = jgfx::BACK
+        .cullMode = jgfx::BACK,
+        .depth = jgfx::DepthState{
+          .testEnabled = true,
+          .writeEnabled = true
+        }
       }
     );
 
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "jgfx.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace jgfx {
+  // Resource of a frame graph, only valid for the frame it was declared in
+  JGFX_HANDLE(FrameGraphResource)
+
+  struct FrameGraph;
+
+  /// <summary>
+  /// Declares the resources used by a pass, given to the setup function of FrameGraph::addPass
+  /// </summary>
+  struct FrameGraphPassBuilder {
+    // read by shaders, e.g. storage buffers or images, vertex or indirect buffers
+    FrameGraphResource read(FrameGraphResource resource);
+    // written by shaders, e.g. storage buffers or images. Passes updating only a part of the content also read it
+    FrameGraphResource write(FrameGraphResource resource);
+    // Attachments of graphics passes. LOAD is turned into DONT_CARE when the image has no content yet,
+    // and the content is not stored when no later pass reads it
+    void setColorAttachment(uint32_t slot, FrameGraphResource image, LoadOp loadOp = LoadOp::LOAD, const float* clearColor = nullptr);
+    void setDepthAttachment(FrameGraphResource image, LoadOp loadOp = LoadOp::LOAD, float clearDepth = 1.0f);
+    void setResolveAttachment(uint32_t slot, FrameGraphResource image);
+    // the pass renders into the default pass, it is never culled
+    void useDefaultPass();
+    // the pass is never culled
+    void setSideEffect();
+
+    FrameGraph* _graph = nullptr;
+    uint32_t _pass = 0;
+  };
+
+  /// <summary>
+  /// Frame graph, built every frame.
+  /// Passes are executed in declaration order, those whose results are never used are culled.
+  /// Transient images of disjoint lifetimes are bound to the same memory, transient buffers are taken from a pool
+  /// when first used and given back after their last use.
+  /// The barriers needed by the resources of a pass are recorded in one batch before it.
+  /// Imported resources are synchronized with their uses outside of the graph by the context only
+  /// </summary>
+  struct FrameGraph {
+    using SetupFunc = std::function<void(FrameGraphPassBuilder& builder)>;
+    // pipelines of graphics passes are created with getPass(), which is only known at execution
+    using ExecuteFunc = std::function<void(Context& ctx, const FrameGraph& graph)>;
+
+    // Transient resources, with a content that only lives during the frame
+    FrameGraphResource createImage(const char* name, const TextureDesc& desc);
+    FrameGraphResource createBuffer(const char* name, uint32_t size, BufferType type);
+    // Resources owned by the application, considered as outputs of the graph
+    FrameGraphResource importImage(const char* name, ImageHandle image);
+    FrameGraphResource importBuffer(const char* name, BufferHandle buffer);
+
+    void addPass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute);
+    // culls unused passes and computes the lifetime of the resources
+    void compile();
+    void execute(Context& ctx);
+    // clears the passes and resources of the frame, pooled images and buffers are kept
+    void reset();
+
+    // Only valid during the execution of the pass using them
+    ImageHandle getImage(FrameGraphResource resource) const;
+    BufferHandle getBuffer(FrameGraphResource resource) const;
+    PassHandle getPass() const;
+
+    struct Resource {
+      std::string name;
+      bool image = true;
+      bool imported = false;
+      TextureDesc textureDesc;
+      uint32_t bufferSize = 0;
+      BufferType bufferType = VERTEX_BUFFER;
+      ImageHandle imageHandle;
+      BufferHandle bufferHandle;
+      uint32_t firstUse = UINT32_MAX; // first and last live passes using the resource
+      uint32_t lastUse = 0;
+      uint32_t pooled = UINT32_MAX; // alias group or pooled buffer of transient resources
+    };
+
+    struct Attachment {
+      FrameGraphResource resource;
+      LoadOp loadOp = LoadOp::LOAD;
+      float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+      float clearDepth = 1.0f;
+    };
+
+    struct Pass {
+      std::string name;
+      ExecuteFunc execute;
+      std::vector<FrameGraphResource> reads;
+      std::vector<FrameGraphResource> writes;
+      Attachment colorAttachments[MAX_COLOR_ATTACHMENTS];
+      Attachment depthAttachment;
+      FrameGraphResource resolveAttachments[MAX_COLOR_ATTACHMENTS];
+      bool defaultPass = false;
+      bool sideEffect = false;
+      uint32_t refCount = 0;
+      bool culled = false;
+    };
+
+    // Images sharing the same memory, kept across frames and used by the frames with the same transient images
+    struct AliasGroup {
+      std::vector<TextureDesc> descs; // in order of first use
+      std::vector<ImageHandle> handles;
+      ResourceState lastState = ResourceState::UNDEFINED; // last access to the memory, by any of the images
+      bool inUse = false;
+    };
+
+    // Pooled buffers, available once the last resource using them is done
+    struct PooledBuffer {
+      uint32_t size = 0;
+      BufferType type = VERTEX_BUFFER;
+      BufferHandle handle;
+      ResourceState lastState = ResourceState::UNDEFINED;
+      bool inUse = false;
+    };
+
+    void acquireImages(Context& ctx);
+    void acquireBuffer(Context& ctx, Resource& resource);
+    ResourceState getState(const Pass& pass, FrameGraphResource resource) const;
+    PassHandle getOrCreatePass(Context& ctx, const Pass& pass, uint32_t passIndex);
+
+    std::vector<Resource> _resources;
+    std::vector<Pass> _passes;
+    std::vector<std::vector<uint32_t>> _aliasedImages; // transient images of the frame grouped by disjoint lifetimes
+    std::vector<AliasGroup> _aliasGroups;
+    std::vector<PooledBuffer> _bufferPool;
+    std::unordered_multimap<uint64_t, std::pair<PassDesc, PassHandle>> _passCache; // passes are created once per set of attachments, keyed by their hash
+    PassHandle _currentPass;
+    bool _compiled = false;
+  };
+}
@@ -6,6 +6,14 @@
 namespace jgfx {
   constexpr uint16_t MAX_BUFFER_BIND = 8;
   constexpr uint16_t MAX_VERTEX_ATTRIBUTES = 16;
+  constexpr uint16_t MAX_STORAGE_BIND = 8;
+  constexpr uint16_t MAX_IMAGE_BIND = 8;
+  constexpr uint16_t MAX_COLOR_ATTACHMENTS = 4;
+  // Bindless descriptor set, arrays indexed with Context::getBindlessIndex
+  constexpr uint16_t BINDLESS_SET = 3;
+  constexpr uint16_t BINDLESS_SAMPLED_IMAGE_BINDING = 0; // all images, with the default sampler
+  constexpr uint16_t BINDLESS_STORAGE_IMAGE_BINDING = 1; // storage images
+  constexpr uint16_t BINDLESS_STORAGE_BUFFER_BINDING = 2; // static storage and indirect buffers
   
   constexpr uint16_t nullHandle = UINT16_MAX;
 
@@ -26,11 +34,24 @@ namespace jgfx {
     OpenGL,
   };
 
+  // FIFO waits for vertical blank, MAILBOX replaces the queued image, IMMEDIATE may tear
+  enum class PresentMode {
+    FIFO,
+    MAILBOX,
+    IMMEDIATE,
+  };
+
   struct InitInfo {
     GraphicsAPI api;
     PlatformData platformData;
     std::vector<const char*> extensionNames;
     Resolution resolution;
+    bool extendedDynamicState = false; // cull mode, face winding and primitive are dynamic states when supported (Vulkan)
+    const char* shaderCacheDir = nullptr; // on disk cache of translated shaders and program binaries (OpenGL), disabled when null
+    uint32_t framesInFlight = 3; // frames recorded while the GPU works on the previous ones, from 1 to 4
+    PresentMode presentMode = PresentMode::MAILBOX; // FIFO when not supported (Vulkan, the window owns the swap interval with OpenGL)
+    bool lowLatency = false; // commitFrame returns once the previous frame is presented, so that input is sampled as late as possible
+    bool bindless = false; // images and buffers are indexed by shaders from BINDLESS_SET (Vulkan with descriptor indexing)
   };
 
   enum AttribType {
@@ -39,12 +60,98 @@ namespace jgfx {
     FLOAT2,
     FLOAT3,
     FLOAT4,
+    HALF2,
+    HALF4,
+    // normalized integers, read as floats in [-1, 1] (signed) or [0, 1] (unsigned)
+    BYTE4_NORM,
+    UBYTE4_NORM,
+    SHORT2_NORM,
+    SHORT4_NORM,
+    USHORT2_NORM,
+    USHORT4_NORM,
+    INT_10_10_10_2_NORM, // x in the lowest bits
+    UINT_10_10_10_2_NORM,
+    // integers, read as ivec/uvec
+    UBYTE4,
+    INT,
+    INT2,
+    INT3,
+    INT4,
+    UINT,
+    UINT2,
+    UINT3,
+    UINT4,
   };
 
   enum BufferType {
     VERTEX_BUFFER,
     INDEX_BUFFER,
     UNIFORM_BUFFER,
+    INDIRECT_BUFFER, // arguments of indirect draws and dispatches, can be written by shaders
+    STORAGE_BUFFER, // read and written by shaders, can also be used as vertex buffer
+  };
+
+  enum class BufferUsage {
+    STATIC, // written once at creation
+    DYNAMIC, // updated from time to time
+    STREAM, // updated every frame
+  };
+
+  enum class IndexType {
+    UINT16,
+    UINT32,
+  };
+
+  enum class TextureFormat {
+    RGBA8_SRGB,
+    RGBA8,
+    RGBA16F,
+    RGBA32F,
+    R32F,
+    // depth formats, for render targets only
+    D32F,
+    D24S8,
+  };
+
+  enum class TextureUsage {
+    SAMPLED,
+    STORAGE, // sampled and written by shaders, needs a non sRGB format
+    RENDER_TARGET, // pass attachment, sampled once the pass is over
+  };
+
+  enum class Filter {
+    NEAREST,
+    LINEAR,
+  };
+
+  // how texture coordinates outside of [0, 1] are handled
+  enum class AddressMode {
+    REPEAT,
+    MIRRORED_REPEAT,
+    CLAMP_TO_EDGE,
+    CLAMP_TO_BORDER, // opaque black border
+  };
+
+  // what happens to the content of an attachment when a pass begins
+  enum class LoadOp {
+    CLEAR,
+    LOAD,
+    DONT_CARE, // previous content is discarded, for attachments fully overwritten by the pass
+  };
+
+  // what happens to the content of an attachment when a pass ends
+  enum class StoreOp {
+    STORE,
+    DONT_CARE, // content is discarded, e.g. depth only used during the pass
+  };
+
+  // how a resource is accessed by a pass
+  enum class ResourceState {
+    UNDEFINED, // not accessed yet
+    SHADER_READ, // read by shaders, or as vertex, index or indirect buffer
+    SHADER_WRITE, // storage written, and possibly read, by shaders
+    COLOR_ATTACHMENT,
+    DEPTH_ATTACHMENT,
   };
   
   enum ShaderStage {
@@ -53,6 +160,11 @@ namespace jgfx {
     ALL,
   };
 
+  enum class VertexStepRate {
+    PER_VERTEX,
+    PER_INSTANCE,
+  };
+
   enum class ShaderType {
     VERTEX,
     FRAGMENT,
@@ -79,6 +191,28 @@ namespace jgfx {
     COUNTER_CLOCKWISE,
   };
 
+  enum class CompareFunc {
+    NEVER,
+    LESS,
+    EQUAL,
+    LESS_EQUAL,
+    GREATER,
+    NOT_EQUAL,
+    GREATER_EQUAL,
+    ALWAYS,
+  };
+
+  enum class StencilOp {
+    KEEP,
+    ZERO,
+    REPLACE,
+    INCR_CLAMP,
+    DECR_CLAMP,
+    INVERT,
+    INCR_WRAP,
+    DECR_WRAP,
+  };
+
   JGFX_HANDLE(ShaderHandle)
   JGFX_HANDLE(ProgramHandle)
   JGFX_HANDLE(PipelineHandle)
@@ -87,39 +221,187 @@ namespace jgfx {
   JGFX_HANDLE(BufferHandle)
   JGFX_HANDLE(UniformBufferHandle)
   JGFX_HANDLE(ImageHandle)
+  JGFX_HANDLE(SamplerHandle)
+  JGFX_HANDLE(CullingHandle)
 
   struct Bindings {
     BufferHandle vertexBuffers[MAX_BUFFER_BIND];
+    uint32_t vertexBufferOffsets[MAX_BUFFER_BIND] = {}; // in bytes
     BufferHandle indexBuffer;
+    IndexType indexType = IndexType::UINT16;
+    uint32_t indexBufferOffset = 0; // in bytes, multiple of the index size
+    // slot i is bound to the shader resource declared with binding = i
+    BufferHandle storageBuffers[MAX_STORAGE_BIND];
+    ImageHandle storageImages[MAX_STORAGE_BIND];
+    // sampled images, slot i is bound to the sampler declared with binding = i, null samplers use the default one
+    ImageHandle images[MAX_IMAGE_BIND];
+    SamplerHandle samplers[MAX_IMAGE_BIND];
   };
 
   struct VertexAttributes {
     void begin();
-    void add(uint32_t location, AttribType type);
+    // binding is the vertex buffer slot of Bindings the attribute is read from.
+    // Attributes are packed after the previous ones of their binding, unless an offset in bytes is given
+    void add(uint32_t location, AttribType type, uint32_t binding = 0);
+    void add(uint32_t location, AttribType type, uint32_t binding, uint32_t offset);
+    // stride in bytes of a binding, computed from its attributes by default. Replaces the computed one at end()
+    void setStride(uint32_t binding, uint32_t stride);
+    void setStepRate(uint32_t binding, VertexStepRate stepRate);
     void end();
 
     uint32_t _offsets[MAX_VERTEX_ATTRIBUTES];
     AttribType _types[MAX_VERTEX_ATTRIBUTES];
-    uint32_t _stride = 0;
+    uint32_t _bindings[MAX_VERTEX_ATTRIBUTES];
+    uint32_t _strides[MAX_BUFFER_BIND]; // 0 for unused bindings
+    uint32_t _explicitStrides[MAX_BUFFER_BIND]; // set by setStride, 0 keeps the computed stride
+    VertexStepRate _stepRates[MAX_BUFFER_BIND];
     uint16_t _attrCount = 0;
   };
 
+  // Layout of the arguments read by drawIndirect
+  struct DrawIndirectCommand {
+    uint32_t vertexCount = 0;
+    uint32_t instanceCount = 0;
+    uint32_t firstVertex = 0;
+    uint32_t firstInstance = 0;
+  };
+
+  // Layout of the arguments read by drawIndexedIndirect
+  struct DrawIndexedIndirectCommand {
+    uint32_t indexCount = 0;
+    uint32_t instanceCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t baseVertex = 0;
+    uint32_t firstInstance = 0;
+  };
+
+  // Layout of the arguments read by dispatchIndirect
+  struct DispatchIndirectCommand {
+    uint32_t groupCountX = 0;
+    uint32_t groupCountY = 0;
+    uint32_t groupCountZ = 0;
+  };
+
+  struct ShaderDesc {
+    ShaderType type = ShaderType::VERTEX;
+    const void* binData = nullptr; // SPIR-V code, must stay valid until the next commitFrame
+    uint32_t size = 0;
+  };
+
+  struct ProgramDesc {
+    ShaderHandle vs;
+    ShaderHandle fs;
+  };
+
+  // Disabled by default, ignored by pipelines of passes without depth attachment.
+  // Fragment shaders writing depth or discarding fragments prevent early depth rejection
+  struct DepthState {
+    bool testEnabled = false;
+    bool writeEnabled = false;
+    CompareFunc compare = CompareFunc::LESS_EQUAL;
+  };
+
+  struct StencilFaceState {
+    CompareFunc compare = CompareFunc::ALWAYS;
+    StencilOp failOp = StencilOp::KEEP;
+    StencilOp depthFailOp = StencilOp::KEEP;
+    StencilOp passOp = StencilOp::KEEP;
+  };
+
+  // Needs a D24S8 depth attachment
+  struct StencilState {
+    bool enabled = false;
+    StencilFaceState front;
+    StencilFaceState back;
+    uint8_t readMask = 0xFF;
+    uint8_t writeMask = 0xFF;
+    uint8_t ref = 0;
+  };
+
   struct PipelineDesc {
     ProgramHandle program;
     VertexAttributes vertexAttributes;
     CullMode cullMode = FRONT;
     FaceWinding faceWinding = CLOCKWISE;
-    PassHandle pass;
+    PassHandle pass; // default pass when null
     PrimitiveType primitive = TRIANGLES;
+    DepthState depth;
+    StencilState stencil;
+    uint8_t colorWriteMask = 0xF; // red to alpha from the lowest bit, 0 for depth only pipelines
   };
 
-  struct PassDesc {
+  struct ComputePipelineDesc {
+    ProgramHandle program; // created with newComputeProgram
+  };
+
+  // Bounding sphere of an object, in world space
+  struct ObjectBounds {
+    float center[3] = {};
+    float radius = 0.0f;
+  };
+
+  struct CullingDesc {
+    BufferHandle bounds; // STORAGE_BUFFER of ObjectBounds, one per object
+    BufferHandle drawArgs; // STORAGE_BUFFER of DrawIndexedIndirectCommand, one per object
+    uint32_t objectCount = 0;
+  };
+
+  struct CullingParams {
+    float viewProj[16] = {}; // column major
+    // Occlusion culling against the depth of the previous frame, skipped when reducedDepth is null.
+    // reducedDepth is a small R32F storage image, each texel holding the farthest depth of the screen area it covers
+    // (e.g. 64x32 for a 1920x1080 depth buffer). Objects covering more than 4x4 of its texels are considered visible.
+    // prevViewProj is the projection of the previous frame, with a [0, 1] depth range
+    ImageHandle reducedDepth;
+    float prevViewProj[16] = {};
+  };
 
+  struct AttachmentDesc {
+    ImageHandle image; // RENDER_TARGET image
+    LoadOp loadOp = LoadOp::CLEAR;
+    StoreOp storeOp = StoreOp::STORE;
+    float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float clearDepth = 1.0f;
+    uint8_t clearStencil = 0;
+  };
+
+  /// <summary>
+  /// Offscreen pass. All attachments must have the same size and sample count.
+  /// Multisampled color attachments are resolved into the single sampled image of the same slot, when given
+  /// </summary>
+  struct PassDesc {
+    AttachmentDesc colorAttachments[MAX_COLOR_ATTACHMENTS]; // used slots come first
+    AttachmentDesc depthAttachment; // unused when its image is null
+    ImageHandle resolveAttachments[MAX_COLOR_ATTACHMENTS];
   };
 
   struct TextureDesc {
     uint32_t width = 0;
     uint32_t height = 0;
+    TextureFormat format = TextureFormat::RGBA8_SRGB;
+    TextureUsage usage = TextureUsage::SAMPLED;
+    uint32_t samples = 1; // more than one for multisampled render targets
+    bool mipmaps = false; // full mip chain generated from the data, single sampled images only (OpenGL)
+  };
+
+  // the default sampler is linear and repeats, without anisotropic filtering
+  struct SamplerDesc {
+    Filter minFilter = Filter::LINEAR;
+    Filter magFilter = Filter::LINEAR;
+    Filter mipmapFilter = Filter::LINEAR;
+    AddressMode addressU = AddressMode::REPEAT;
+    AddressMode addressV = AddressMode::REPEAT;
+    AddressMode addressW = AddressMode::REPEAT;
+    float maxAnisotropy = 1.0f; // 1 disables anisotropic filtering, clamped to the device limit
+  };
+
+  // Dependency between the accesses of a resource before and after the barrier
+  struct ResourceBarrier {
+    ImageHandle image; // null for buffers
+    BufferHandle buffer;
+    ResourceState before = ResourceState::UNDEFINED;
+    ResourceState after = ResourceState::SHADER_READ;
+    bool discard = false; // the content is not kept, e.g. the memory was used by another aliased image
   };
 
   struct Context {
@@ -132,17 +414,66 @@ namespace jgfx {
     PassHandle newPass(const PassDesc& passDesc);
     ShaderHandle newShader(ShaderType type, const void* binData, uint32_t size);
     ProgramHandle newProgram(ShaderHandle vs, ShaderHandle fs);
-    BufferHandle newBuffer(const void* data, uint32_t size, BufferType type);
+    ProgramHandle newComputeProgram(ShaderHandle cs);
+    PipelineHandle newComputePipeline(const ComputePipelineDesc& pipelineDesc);
+    // Pipelines of a depth prepass: the scene is drawn first with the prepass pipeline, which only writes depth,
+    // then with the shading pipeline, which only shades the visible fragments (depth test equal, no depth write)
+    void newDepthPrepassPipelines(const PipelineDesc& pipelineDesc, PipelineHandle* prepass, PipelineHandle* shading);
+    // Batch creation, shaders are translated and reflected in parallel
+    void newShaders(const ShaderDesc* descs, uint32_t count, ShaderHandle* handles);
+    void newPrograms(const ProgramDesc* descs, uint32_t count, ProgramHandle* handles);
+    BufferHandle newBuffer(const void* data, uint32_t size, BufferType type, BufferUsage usage = BufferUsage::STATIC);
+    // Updates of dynamic and stream buffers, buffers get more copies when updated more than once per frame.
+    // Bindings applied before the update keep the previous content.
+    // The data is copied, bytes past size are undefined afterwards
+    void updateBuffer(BufferHandle buffer, const void* data, uint32_t size);
+    // same as updateBuffer, the returned memory is filled by the caller until commitFrame
+    void* mapBuffer(BufferHandle buffer, uint32_t size);
     ImageHandle newImage(const void* data, uint32_t size, const TextureDesc& desc);
+    // Images bound to the same memory, sized for the largest one. Only one of them can hold content at a time,
+    // the next one discards it with a barrier. OpenGL creates separate images, as does Vulkan when
+    // they can't share memory
+    void newAliasedImages(const TextureDesc* descs, uint32_t count, ImageHandle* handles);
+    // identical descriptions share the same sampler
+    SamplerHandle newSampler(const SamplerDesc& desc);
+    // Bindless mode, false when not requested or not supported. Shaders declare the bindings of BINDLESS_SET
+    // as runtime sized arrays and index them with indices given through uniforms
+    bool isBindless();
+    uint32_t getBindlessIndex(ImageHandle image);
+    uint32_t getBindlessIndex(BufferHandle buffer);
     // Drawing
     void beginDefaultPass();
     void beginPass(PassHandle pass);
     void applyPipeline(PipelineHandle pipe);
     void applyBindings(const Bindings& bindings);
+    // data of the only uniform block of the program, declared in set 0
     void applyUniforms(ShaderStage stage, const void* data, uint32_t size);
-    void draw(uint32_t firstVertex, uint32_t vertexCount);
-    void drawIndexed(uint32_t firstIndex, uint32_t indexCount);
+    // Overrides of the current pipeline state, valid until the next applyPipeline
+    void setCullMode(CullMode mode);
+    void setFaceWinding(FaceWinding faceWinding);
+    void setPrimitiveType(PrimitiveType primitive);
+    void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+    // baseVertex is added to the indices read from the index buffer
+    void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstInstance = 0, int32_t baseVertex = 0);
+    // Draws with arguments read from an indirect buffer, offsets are in bytes
+    void drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount);
+    // Indexed indirect draws are skipped unless the index buffer is static and bound without offset
+    void drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount);
+    // The draw count is read as an uint32_t from countBuffer, and clamped to maxDrawCount
+    void drawIndirectCount(BufferHandle buffer, uint32_t offset, BufferHandle countBuffer, uint32_t countOffset, uint32_t maxDrawCount);
+    void drawIndexedIndirectCount(BufferHandle buffer, uint32_t offset, BufferHandle countBuffer, uint32_t countOffset, uint32_t maxDrawCount);
     void endPass();
+    // Outside of passes, batched and recorded before the next pass or dispatch
+    void barrier(const ResourceBarrier* barriers, uint32_t count);
+    // Compute, outside of passes. Writes are visible to the following dispatches and passes
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+    void dispatchIndirect(BufferHandle buffer, uint32_t offset);
+    // GPU culling: a compute pass writes the draw arguments of the visible objects in a compacted list
+    CullingHandle newCulling(const CullingDesc& desc);
+    // outside of passes, once per frame and culling stage
+    void cull(CullingHandle culling, const CullingParams& params);
+    // draws the visible objects with the current pipeline and bindings
+    void drawCulled(CullingHandle culling);
     void commitFrame();
   };
 }
@@ -0,0 +1,37 @@
+#include "culling.h"
+
+#include <cmath>
+
+namespace jgfx {
+  const uint32_t CULLING_SHADER[] =
+#include "shaders/cull.comp.inl"
+  ;
+  const uint32_t CULLING_SHADER_SIZE = sizeof(CULLING_SHADER);
+
+  void extractFrustumPlanes(const float* viewProj, float planes[6][4]) {
+    // row i of a column major matrix
+    auto row = [&](int i, int j) {
+      return viewProj[j * 4 + i];
+    };
+
+    for (int j = 0; j < 4; j++) {
+      planes[0][j] = row(3, j) + row(0, j); // left
+      planes[1][j] = row(3, j) - row(0, j); // right
+      planes[2][j] = row(3, j) + row(1, j); // bottom
+      planes[3][j] = row(3, j) - row(1, j); // top
+      planes[4][j] = row(3, j) + row(2, j); // near
+      planes[5][j] = row(3, j) - row(2, j); // far
+    }
+
+    // normalized so that sphere tests can compare distances with radii
+    for (int i = 0; i < 6; i++) {
+      float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+      if (length == 0.0f)
+        continue;
+
+      for (int j = 0; j < 4; j++) {
+        planes[i][j] /= length;
+      }
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "jgfx/jgfx.h"
+
+namespace jgfx {
+  constexpr int MAX_CULLING_STAGES = 64;
+  constexpr uint32_t CULLING_GROUP_SIZE = 64; // local size of src/shaders/cull.comp
+
+  // binding points of src/shaders/cull.comp, storage slots match them
+  constexpr uint32_t CULLING_BOUNDS_SLOT = 1;
+  constexpr uint32_t CULLING_DRAW_ARGS_SLOT = 2;
+  constexpr uint32_t CULLING_VISIBLE_ARGS_SLOT = 3;
+  constexpr uint32_t CULLING_VISIBLE_COUNT_SLOT = 4;
+  constexpr uint32_t CULLING_REDUCED_DEPTH_SLOT = 5;
+
+  // SPIR-V of src/shaders/cull.comp, regenerated by src/shaders/shader_compile.bat
+  extern const uint32_t CULLING_SHADER[];
+  extern const uint32_t CULLING_SHADER_SIZE; // in bytes
+
+  /// <summary>
+  /// Uniform block of src/shaders/cull.comp, std140 layout
+  /// </summary>
+  struct CullingUniforms {
+    float frustumPlanes[6][4]; // normalized, xyz . p + w >= 0 inside
+    float prevViewProj[16];
+    uint32_t objectCount;
+    uint32_t occlusion; // 1 when a reduced depth image is given
+    uint32_t padding[2];
+  };
+
+  /// <summary>
+  /// Resources of a culling stage
+  /// </summary>
+  struct CullingStage {
+    CullingDesc desc;
+    BufferHandle visibleArgs; // compacted draw arguments of the visible objects
+    BufferHandle visibleCount; // number of visible objects
+  };
+
+  /// <summary>
+  /// Extracts the frustum planes of a column major view projection matrix.
+  /// The near plane is the one of a [-1, 1] depth range, which is conservative for [0, 1] ranges
+  /// </summary>
+  void extractFrustumPlanes(const float* viewProj, float planes[6][4]);
+}
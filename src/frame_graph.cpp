@@ -0,0 +1,464 @@
+#include "jgfx/frame_graph.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace jgfx {
+  namespace {
+    bool isSameTextureDesc(const TextureDesc& a, const TextureDesc& b) {
+      return a.width == b.width && a.height == b.height && a.format == b.format && a.usage == b.usage && a.samples == b.samples;
+    }
+  }
+
+  FrameGraphResource FrameGraphPassBuilder::read(FrameGraphResource resource) {
+    _graph->_passes[_pass].reads.push_back(resource);
+    return resource;
+  }
+
+  FrameGraphResource FrameGraphPassBuilder::write(FrameGraphResource resource) {
+    _graph->_passes[_pass].writes.push_back(resource);
+    return resource;
+  }
+
+  void FrameGraphPassBuilder::setColorAttachment(uint32_t slot, FrameGraphResource image, LoadOp loadOp, const float* clearColor) {
+    if (slot >= MAX_COLOR_ATTACHMENTS)
+      return; // todo error handling
+
+    FrameGraph::Attachment& attachment = _graph->_passes[_pass].colorAttachments[slot];
+    attachment.resource = image;
+    attachment.loadOp = loadOp;
+    if (clearColor) {
+      for (int i = 0; i < 4; i++)
+        attachment.clearColor[i] = clearColor[i];
+    }
+
+    // loading needs the content written by previous passes
+    if (loadOp == LoadOp::LOAD)
+      read(image);
+    write(image);
+  }
+
+  void FrameGraphPassBuilder::setDepthAttachment(FrameGraphResource image, LoadOp loadOp, float clearDepth) {
+    FrameGraph::Attachment& attachment = _graph->_passes[_pass].depthAttachment;
+    attachment.resource = image;
+    attachment.loadOp = loadOp;
+    attachment.clearDepth = clearDepth;
+
+    if (loadOp == LoadOp::LOAD)
+      read(image);
+    write(image);
+  }
+
+  void FrameGraphPassBuilder::setResolveAttachment(uint32_t slot, FrameGraphResource image) {
+    if (slot >= MAX_COLOR_ATTACHMENTS)
+      return; // todo error handling
+
+    _graph->_passes[_pass].resolveAttachments[slot] = image;
+    write(image);
+  }
+
+  void FrameGraphPassBuilder::useDefaultPass() {
+    _graph->_passes[_pass].defaultPass = true;
+  }
+
+  void FrameGraphPassBuilder::setSideEffect() {
+    _graph->_passes[_pass].sideEffect = true;
+  }
+
+  FrameGraphResource FrameGraph::createImage(const char* name, const TextureDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.textureDesc = desc;
+    _resources.push_back(resource);
+    return { static_cast<uint16_t>(_resources.size() - 1) };
+  }
+
+  FrameGraphResource FrameGraph::createBuffer(const char* name, uint32_t size, BufferType type) {
+    Resource resource;
+    resource.name = name;
+    resource.image = false;
+    resource.bufferSize = size;
+    resource.bufferType = type;
+    _resources.push_back(resource);
+    return { static_cast<uint16_t>(_resources.size() - 1) };
+  }
+
+  FrameGraphResource FrameGraph::importImage(const char* name, ImageHandle image) {
+    Resource resource;
+    resource.name = name;
+    resource.imported = true;
+    resource.imageHandle = image;
+    _resources.push_back(resource);
+    return { static_cast<uint16_t>(_resources.size() - 1) };
+  }
+
+  FrameGraphResource FrameGraph::importBuffer(const char* name, BufferHandle buffer) {
+    Resource resource;
+    resource.name = name;
+    resource.image = false;
+    resource.imported = true;
+    resource.bufferHandle = buffer;
+    _resources.push_back(resource);
+    return { static_cast<uint16_t>(_resources.size() - 1) };
+  }
+
+  void FrameGraph::addPass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    _passes.push_back(pass);
+
+    FrameGraphPassBuilder builder;
+    builder._graph = this;
+    builder._pass = static_cast<uint32_t>(_passes.size() - 1);
+    setup(builder);
+    _compiled = false;
+  }
+
+  void FrameGraph::compile() {
+    // Every write makes a new version of the resource, read by the following passes until the next write.
+    // Versions are referenced by the passes reading them, passes by the versions they write
+    struct Version {
+      uint32_t writer = 0;
+      uint32_t refCount = 0;
+    };
+    std::vector<Version> versions;
+    std::vector<uint32_t> currentVersions(_resources.size(), UINT32_MAX);
+    std::vector<std::vector<uint32_t>> readVersions(_passes.size());
+    for (uint32_t i = 0; i < _passes.size(); i++) {
+      Pass& pass = _passes[i];
+      pass.refCount = 0;
+      pass.culled = false;
+      // reads come first, a pass loading an attachment depends on the previous writers
+      for (FrameGraphResource resource : pass.reads) {
+        uint32_t version = currentVersions[resource.id];
+        if (version == UINT32_MAX)
+          continue;
+        readVersions[i].push_back(version);
+        versions[version].refCount++;
+      }
+      for (FrameGraphResource resource : pass.writes) {
+        currentVersions[resource.id] = static_cast<uint32_t>(versions.size());
+        versions.push_back({ i, 0 });
+        pass.refCount++;
+      }
+    }
+    // the final content of imported resources is the output of the frame
+    for (uint32_t i = 0; i < _resources.size(); i++) {
+      if (_resources[i].imported && currentVersions[i] != UINT32_MAX)
+        versions[currentVersions[i]].refCount++;
+    }
+
+    // passes without reference nor side effect are culled, which may leave the versions they read unused
+    std::vector<uint32_t> unusedVersions;
+    for (uint32_t i = 0; i < versions.size(); i++) {
+      if (versions[i].refCount == 0)
+        unusedVersions.push_back(i);
+    }
+    auto cullPass = [&](uint32_t passIndex) {
+      _passes[passIndex].culled = true;
+      for (uint32_t version : readVersions[passIndex]) {
+        if (--versions[version].refCount == 0)
+          unusedVersions.push_back(version);
+      }
+    };
+    auto isCullable = [](const Pass& pass) {
+      return !pass.sideEffect && !pass.defaultPass && !pass.culled;
+    };
+
+    for (uint32_t i = 0; i < _passes.size(); i++) {
+      if (_passes[i].refCount == 0 && isCullable(_passes[i]))
+        cullPass(i);
+    }
+    while (!unusedVersions.empty()) {
+      uint32_t writer = versions[unusedVersions.back()].writer;
+      unusedVersions.pop_back();
+      Pass& pass = _passes[writer];
+      if (pass.refCount > 0 && --pass.refCount == 0 && isCullable(pass))
+        cullPass(writer);
+    }
+
+    // lifetimes over the live passes
+    for (Resource& resource : _resources) {
+      resource.firstUse = UINT32_MAX;
+      resource.lastUse = 0;
+    }
+    for (uint32_t i = 0; i < _passes.size(); i++) {
+      const Pass& pass = _passes[i];
+      if (pass.culled)
+        continue;
+
+      for (const std::vector<FrameGraphResource>* resources : { &pass.reads, &pass.writes }) {
+        for (FrameGraphResource resource : *resources) {
+          Resource& res = _resources[resource.id];
+          res.firstUse = std::min(res.firstUse, i);
+          res.lastUse = std::max(res.lastUse, i);
+        }
+      }
+    }
+
+    // transient images share the memory of those whose lifetime is over
+    std::vector<uint32_t> images;
+    for (uint32_t i = 0; i < _resources.size(); i++) {
+      const Resource& resource = _resources[i];
+      if (resource.image && !resource.imported && resource.firstUse != UINT32_MAX)
+        images.push_back(i);
+    }
+    std::stable_sort(images.begin(), images.end(), [&](uint32_t a, uint32_t b) {
+      return _resources[a].firstUse < _resources[b].firstUse;
+    });
+    _aliasedImages.clear();
+    for (uint32_t image : images) {
+      auto group = std::find_if(_aliasedImages.begin(), _aliasedImages.end(), [&](const std::vector<uint32_t>& group) {
+        return _resources[group.back()].lastUse < _resources[image].firstUse;
+      });
+      if (group == _aliasedImages.end())
+        _aliasedImages.emplace_back(1, image);
+      else
+        group->push_back(image);
+    }
+
+    _compiled = true;
+  }
+
+  void FrameGraph::execute(Context& ctx) {
+    if (!_compiled)
+      compile();
+
+    acquireImages(ctx);
+
+    std::vector<ResourceState> states(_resources.size(), ResourceState::UNDEFINED);
+    std::vector<uint32_t> visited(_resources.size(), UINT32_MAX);
+    std::vector<ResourceBarrier> barriers;
+    for (uint32_t i = 0; i < _passes.size(); i++) {
+      const Pass& pass = _passes[i];
+      if (pass.culled)
+        continue;
+
+      // barriers against the previous accesses of the resources, or of their memory for transient ones
+      barriers.clear();
+      for (const std::vector<FrameGraphResource>* resources : { &pass.reads, &pass.writes }) {
+        for (FrameGraphResource resource : *resources) {
+          if (visited[resource.id] == i)
+            continue;
+          visited[resource.id] = i;
+
+          Resource& res = _resources[resource.id];
+          ResourceState* memoryState = nullptr;
+          if (!res.imported && !res.image) {
+            if (res.firstUse == i)
+              acquireBuffer(ctx, res);
+            memoryState = &_bufferPool[res.pooled].lastState;
+          }
+          else if (!res.imported) {
+            memoryState = &_aliasGroups[res.pooled].lastState;
+          }
+
+          bool discard = !res.imported && res.firstUse == i;
+          ResourceBarrier barrier;
+          barrier.image = res.image ? res.imageHandle : ImageHandle();
+          barrier.buffer = res.image ? BufferHandle() : res.bufferHandle;
+          barrier.before = discard ? *memoryState : states[resource.id];
+          barrier.after = getState(pass, resource);
+          barrier.discard = discard && res.image;
+          // reads following reads, and first accesses, don't wait
+          bool readAfterRead = barrier.before == ResourceState::SHADER_READ && barrier.after == ResourceState::SHADER_READ;
+          if (barrier.before != ResourceState::UNDEFINED && !readAfterRead)
+            barriers.push_back(barrier);
+
+          states[resource.id] = barrier.after;
+          if (memoryState)
+            *memoryState = barrier.after;
+        }
+      }
+      ctx.barrier(barriers.data(), static_cast<uint32_t>(barriers.size()));
+
+      if (pass.defaultPass) {
+        _currentPass = PassHandle();
+        ctx.beginDefaultPass();
+        pass.execute(ctx, *this);
+        ctx.endPass();
+      }
+      else if (pass.colorAttachments[0].resource.id != nullHandle || pass.depthAttachment.resource.id != nullHandle) {
+        _currentPass = getOrCreatePass(ctx, pass, i);
+        ctx.beginPass(_currentPass);
+        pass.execute(ctx, *this);
+        ctx.endPass();
+      }
+      else {
+        // compute or transfer work, outside of passes
+        _currentPass = PassHandle();
+        pass.execute(ctx, *this);
+      }
+
+      // buffers no longer used can be taken by the following resources
+      for (const Resource& resource : _resources) {
+        if (!resource.imported && !resource.image && resource.firstUse != UINT32_MAX && resource.lastUse == i)
+          _bufferPool[resource.pooled].inUse = false;
+      }
+    }
+
+    for (AliasGroup& group : _aliasGroups)
+      group.inUse = false;
+    _currentPass = PassHandle();
+  }
+
+  void FrameGraph::reset() {
+    _resources.clear();
+    _passes.clear();
+    _compiled = false;
+  }
+
+  ImageHandle FrameGraph::getImage(FrameGraphResource resource) const {
+    return _resources[resource.id].imageHandle;
+  }
+
+  BufferHandle FrameGraph::getBuffer(FrameGraphResource resource) const {
+    return _resources[resource.id].bufferHandle;
+  }
+
+  PassHandle FrameGraph::getPass() const {
+    return _currentPass;
+  }
+
+  void FrameGraph::acquireImages(Context& ctx) {
+    for (const std::vector<uint32_t>& images : _aliasedImages) {
+      std::vector<TextureDesc> descs;
+      for (uint32_t image : images)
+        descs.push_back(_resources[image].textureDesc);
+
+      // groups are reused by the frames with the same images
+      auto group = std::find_if(_aliasGroups.begin(), _aliasGroups.end(), [&](const AliasGroup& group) {
+        if (group.inUse || group.descs.size() != descs.size())
+          return false;
+        for (size_t i = 0; i < descs.size(); i++) {
+          if (!isSameTextureDesc(group.descs[i], descs[i]))
+            return false;
+        }
+        return true;
+      });
+      if (group == _aliasGroups.end()) {
+        AliasGroup newGroup;
+        newGroup.descs = descs;
+        newGroup.handles.resize(descs.size());
+        ctx.newAliasedImages(descs.data(), static_cast<uint32_t>(descs.size()), newGroup.handles.data());
+        _aliasGroups.push_back(newGroup);
+        group = _aliasGroups.end() - 1;
+      }
+
+      group->inUse = true;
+      for (size_t i = 0; i < images.size(); i++) {
+        Resource& resource = _resources[images[i]];
+        resource.imageHandle = group->handles[i];
+        resource.pooled = static_cast<uint32_t>(group - _aliasGroups.begin());
+      }
+    }
+  }
+
+  void FrameGraph::acquireBuffer(Context& ctx, Resource& resource) {
+    // the smallest free buffer large enough
+    PooledBuffer* best = nullptr;
+    for (PooledBuffer& pooled : _bufferPool) {
+      if (!pooled.inUse && pooled.type == resource.bufferType && pooled.size >= resource.bufferSize) {
+        if (!best || pooled.size < best->size)
+          best = &pooled;
+      }
+    }
+    if (!best) {
+      PooledBuffer pooled;
+      pooled.size = resource.bufferSize;
+      pooled.type = resource.bufferType;
+      pooled.handle = ctx.newBuffer(nullptr, resource.bufferSize, resource.bufferType);
+      _bufferPool.push_back(pooled);
+      best = &_bufferPool.back();
+    }
+
+    best->inUse = true;
+    resource.bufferHandle = best->handle;
+    resource.pooled = static_cast<uint32_t>(best - _bufferPool.data());
+  }
+
+  ResourceState FrameGraph::getState(const Pass& pass, FrameGraphResource resource) const {
+    if (pass.depthAttachment.resource.id == resource.id)
+      return ResourceState::DEPTH_ATTACHMENT;
+    for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+      if (pass.colorAttachments[i].resource.id == resource.id || pass.resolveAttachments[i].id == resource.id)
+        return ResourceState::COLOR_ATTACHMENT;
+    }
+
+    auto written = std::find_if(pass.writes.begin(), pass.writes.end(), [&](FrameGraphResource write) {
+      return write.id == resource.id;
+    });
+    return written != pass.writes.end() ? ResourceState::SHADER_WRITE : ResourceState::SHADER_READ;
+  }
+
+  PassHandle FrameGraph::getOrCreatePass(Context& ctx, const Pass& pass, uint32_t passIndex) {
+    // content that nobody reads doesn't need to be loaded nor stored
+    auto toPassAttachment = [&](const Attachment& attachment, AttachmentDesc& desc) {
+      const Resource& resource = _resources[attachment.resource.id];
+      desc.image = resource.imageHandle;
+      desc.loadOp = attachment.loadOp;
+      if (desc.loadOp == LoadOp::LOAD && !resource.imported && resource.firstUse == passIndex)
+        desc.loadOp = LoadOp::DONT_CARE;
+      desc.storeOp = !resource.imported && resource.lastUse == passIndex ? StoreOp::DONT_CARE : StoreOp::STORE;
+      for (int i = 0; i < 4; i++)
+        desc.clearColor[i] = attachment.clearColor[i];
+      desc.clearDepth = attachment.clearDepth;
+    };
+
+    PassDesc desc;
+    for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+      if (pass.colorAttachments[i].resource.id != nullHandle)
+        toPassAttachment(pass.colorAttachments[i], desc.colorAttachments[i]);
+      if (pass.resolveAttachments[i].id != nullHandle)
+        desc.resolveAttachments[i] = _resources[pass.resolveAttachments[i].id].imageHandle;
+    }
+    if (pass.depthAttachment.resource.id != nullHandle)
+      toPassAttachment(pass.depthAttachment, desc.depthAttachment);
+
+    Hasher hasher;
+    auto hashAttachment = [&](const AttachmentDesc& attachment) {
+      hasher.add(attachment.image.id);
+      hasher.add(attachment.loadOp);
+      hasher.add(attachment.storeOp);
+      hasher.add(attachment.clearColor);
+      hasher.add(attachment.clearDepth);
+      hasher.add(attachment.clearStencil);
+    };
+    for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+      hashAttachment(desc.colorAttachments[i]);
+      hasher.add(desc.resolveAttachments[i].id);
+    }
+    hashAttachment(desc.depthAttachment);
+
+    auto isSameAttachment = [](const AttachmentDesc& a, const AttachmentDesc& b) {
+      return a.image.id == b.image.id
+        && a.loadOp == b.loadOp
+        && a.storeOp == b.storeOp
+        && memcmp(a.clearColor, b.clearColor, sizeof(a.clearColor)) == 0
+        && a.clearDepth == b.clearDepth
+        && a.clearStencil == b.clearStencil;
+    };
+    auto isSamePass = [&](const PassDesc& a, const PassDesc& b) {
+      for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+        if (!isSameAttachment(a.colorAttachments[i], b.colorAttachments[i]) || a.resolveAttachments[i].id != b.resolveAttachments[i].id)
+          return false;
+      }
+      return isSameAttachment(a.depthAttachment, b.depthAttachment);
+    };
+
+    // the descriptions are compared since hashes may collide
+    uint64_t key = hasher.get();
+    auto range = _passCache.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (isSamePass(it->second.first, desc))
+        return it->second.second;
+    }
+
+    PassHandle handle = ctx.newPass(desc);
+    _passCache.emplace(key, std::make_pair(desc, handle));
+    return handle;
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <utility>
+
+namespace jgfx {
+  /// <summary>
+  /// Incremental FNV-1a 64 bits hasher
+  /// Used to build cache keys from descriptors. Hash fields one by one rather
+  /// than whole structs to avoid hashing padding bytes
+  /// </summary>
+  struct Hasher {
+    static constexpr uint64_t OFFSET_BASIS = 14695981039346656037ull;
+    static constexpr uint64_t PRIME = 1099511628211ull;
+
+    void add(const void* data, size_t size) {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      for (size_t i = 0; i < size; i++) {
+        _hash ^= bytes[i];
+        _hash *= PRIME;
+      }
+    }
+
+    template<typename T>
+    void add(const T& value) {
+      add(&value, sizeof(value));
+    }
+
+    uint64_t get() const {
+      return _hash;
+    }
+
+    uint64_t _hash = OFFSET_BASIS;
+  };
+
+  /// <summary>
+  /// Values keyed by the hash of their description.
+  /// Descriptions are kept and compared on lookups, so that a hash collision never returns the value of another description
+  /// </summary>
+  template<typename Key, typename Value>
+  struct HashCache {
+    // equal(a, b) compares two descriptions, null when none is equal to key
+    template<typename Equal>
+    Value* find(uint64_t hash, const Key& key, Equal equal) {
+      auto range = _entries.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (equal(it->second.first, key))
+          return &it->second.second;
+      }
+      return nullptr;
+    }
+
+    // values are never moved by later insertions
+    Value& insert(uint64_t hash, const Key& key, const Value& value) {
+      return _entries.emplace(hash, std::make_pair(key, value))->second.second;
+    }
+
+    void clear() {
+      _entries.clear();
+    }
+
+    std::unordered_multimap<uint64_t, std::pair<Key, Value>> _entries;
+  };
+}
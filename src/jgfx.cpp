@@ -1,6 +1,8 @@
 #include "jgfx/jgfx.h"
 #include "jgfx_impl.h"
 
+#include <algorithm>
+
 namespace jgfx 
 {
   static ContextImpl ctx; 
@@ -33,14 +35,62 @@ namespace jgfx
     return ctx.newProgram(vs, fs);
   }
 
-  BufferHandle Context::newBuffer(const void* data, uint32_t size, BufferType type) {
-    return ctx.newBuffer(data, size, type);
+  ProgramHandle Context::newComputeProgram(ShaderHandle cs) {
+    return ctx.newComputeProgram(cs);
+  }
+
+  PipelineHandle Context::newComputePipeline(const ComputePipelineDesc& pipelineDesc) {
+    return ctx.newComputePipeline(pipelineDesc);
+  }
+
+  void Context::newDepthPrepassPipelines(const PipelineDesc& pipelineDesc, PipelineHandle* prepass, PipelineHandle* shading) {
+    ctx.newDepthPrepassPipelines(pipelineDesc, prepass, shading);
+  }
+
+  void Context::newShaders(const ShaderDesc* descs, uint32_t count, ShaderHandle* handles) {
+    ctx.newShaders(descs, count, handles);
+  }
+
+  void Context::newPrograms(const ProgramDesc* descs, uint32_t count, ProgramHandle* handles) {
+    ctx.newPrograms(descs, count, handles);
+  }
+
+  BufferHandle Context::newBuffer(const void* data, uint32_t size, BufferType type, BufferUsage usage) {
+    return ctx.newBuffer(data, size, type, usage);
+  }
+
+  void Context::updateBuffer(BufferHandle buffer, const void* data, uint32_t size) {
+    ctx.updateBuffer(buffer, data, size);
+  }
+
+  void* Context::mapBuffer(BufferHandle buffer, uint32_t size) {
+    return ctx.mapBuffer(buffer, size);
   }
 
   ImageHandle Context::newImage(const void* data, uint32_t size, const TextureDesc& desc) {
     return ctx.newImage(data, size, desc);
   }
 
+  void Context::newAliasedImages(const TextureDesc* descs, uint32_t count, ImageHandle* handles) {
+    ctx.newAliasedImages(descs, count, handles);
+  }
+
+  SamplerHandle Context::newSampler(const SamplerDesc& desc) {
+    return ctx.newSampler(desc);
+  }
+
+  bool Context::isBindless() {
+    return ctx.isBindless();
+  }
+
+  uint32_t Context::getBindlessIndex(ImageHandle image) {
+    return ctx.getBindlessIndex(image);
+  }
+
+  uint32_t Context::getBindlessIndex(BufferHandle buffer) {
+    return ctx.getBindlessIndex(buffer);
+  }
+
   void Context::beginDefaultPass() {
     ctx.beginDefaultPass();
   }
@@ -61,18 +111,70 @@ namespace jgfx
     ctx.applyUniforms(stage, data, size);
   }
 
-  void Context::draw(uint32_t firstVertex, uint32_t vertexCount) {
-    ctx.draw(firstVertex, vertexCount);
+  void Context::setCullMode(CullMode mode) {
+    ctx.setCullMode(mode);
+  }
+
+  void Context::setFaceWinding(FaceWinding faceWinding) {
+    ctx.setFaceWinding(faceWinding);
+  }
+
+  void Context::setPrimitiveType(PrimitiveType primitive) {
+    ctx.setPrimitiveType(primitive);
+  }
+
+  void Context::draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) {
+    ctx.draw(firstVertex, vertexCount, instanceCount, firstInstance);
+  }
+
+  void Context::drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) {
+    ctx.drawIndexed(firstIndex, indexCount, instanceCount, firstInstance, baseVertex);
   }
 
-  void Context::drawIndexed(uint32_t firstIndex, uint32_t indexCount) {
-    ctx.drawIndexed(firstIndex, indexCount);
+  void Context::drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount) {
+    ctx.drawIndirect(buffer, offset, drawCount, BufferHandle(), 0);
+  }
+
+  void Context::drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount) {
+    ctx.drawIndexedIndirect(buffer, offset, drawCount, BufferHandle(), 0);
+  }
+
+  void Context::drawIndirectCount(BufferHandle buffer, uint32_t offset, BufferHandle countBuffer, uint32_t countOffset, uint32_t maxDrawCount) {
+    ctx.drawIndirect(buffer, offset, maxDrawCount, countBuffer, countOffset);
+  }
+
+  void Context::drawIndexedIndirectCount(BufferHandle buffer, uint32_t offset, BufferHandle countBuffer, uint32_t countOffset, uint32_t maxDrawCount) {
+    ctx.drawIndexedIndirect(buffer, offset, maxDrawCount, countBuffer, countOffset);
   }
 
   void Context::endPass() {
     ctx.endPass();
   }
 
+  void Context::barrier(const ResourceBarrier* barriers, uint32_t count) {
+    ctx.barrier(barriers, count);
+  }
+
+  void Context::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    ctx.dispatch(groupCountX, groupCountY, groupCountZ);
+  }
+
+  void Context::dispatchIndirect(BufferHandle buffer, uint32_t offset) {
+    ctx.dispatchIndirect(buffer, offset);
+  }
+
+  CullingHandle Context::newCulling(const CullingDesc& desc) {
+    return ctx.newCulling(desc);
+  }
+
+  void Context::cull(CullingHandle culling, const CullingParams& params) {
+    ctx.cull(culling, params);
+  }
+
+  void Context::drawCulled(CullingHandle culling) {
+    ctx.drawCulled(culling);
+  }
+
   void Context::commitFrame() {
     ctx.commitFrame();
   }
@@ -80,7 +182,12 @@ namespace jgfx
   void VertexAttributes::begin() {
     memset(_offsets, 0, sizeof(_offsets));
     memset(_types, UNKNOWN, sizeof(_types));
-    _stride = 0;
+    memset(_bindings, 0, sizeof(_bindings));
+    memset(_strides, 0, sizeof(_strides));
+    memset(_explicitStrides, 0, sizeof(_explicitStrides));
+    for (int i = 0; i < MAX_BUFFER_BIND; i++) {
+      _stepRates[i] = VertexStepRate::PER_VERTEX;
+    }
     _attrCount = 0;
   }
 
@@ -91,23 +198,69 @@ namespace jgfx
     case FLOAT2: return 2 * sizeof(float);
     case FLOAT3: return 3 * sizeof(float);
     case FLOAT4: return 4 * sizeof(float);
+    case HALF2: return 2 * sizeof(uint16_t);
+    case HALF4: return 4 * sizeof(uint16_t);
+    case BYTE4_NORM:
+    case UBYTE4_NORM: return 4 * sizeof(uint8_t);
+    case SHORT2_NORM:
+    case USHORT2_NORM: return 2 * sizeof(uint16_t);
+    case SHORT4_NORM:
+    case USHORT4_NORM: return 4 * sizeof(uint16_t);
+    case INT_10_10_10_2_NORM:
+    case UINT_10_10_10_2_NORM: return sizeof(uint32_t);
+    case UBYTE4: return 4 * sizeof(uint8_t);
+    case INT:
+    case UINT: return sizeof(uint32_t);
+    case INT2:
+    case UINT2: return 2 * sizeof(uint32_t);
+    case INT3:
+    case UINT3: return 3 * sizeof(uint32_t);
+    case INT4:
+    case UINT4: return 4 * sizeof(uint32_t);
     }
 
     return 0;
   }
 
-  void VertexAttributes::add(uint32_t location, AttribType type) {
-    if (location >= MAX_VERTEX_ATTRIBUTES)
+  void VertexAttributes::add(uint32_t location, AttribType type, uint32_t binding) {
+    if (binding >= MAX_BUFFER_BIND)
+      return; // todo error handling
+
+    // attributes of a binding are interleaved, _strides holds the end of the attributes until end()
+    add(location, type, binding, _strides[binding]);
+  }
+
+  void VertexAttributes::add(uint32_t location, AttribType type, uint32_t binding, uint32_t offset) {
+    if (location >= MAX_VERTEX_ATTRIBUTES || binding >= MAX_BUFFER_BIND)
       return; // todo error handling
 
-    _offsets[location] = _stride;
+    _offsets[location] = offset;
     _types[location] = type;
-    _stride += getSizeOf(type);
+    _bindings[location] = binding;
+    _strides[binding] = std::max(_strides[binding], offset + getSizeOf(type));
     _attrCount += 1;
   }
 
-  void VertexAttributes::end() {
+  void VertexAttributes::setStride(uint32_t binding, uint32_t stride) {
+    if (binding >= MAX_BUFFER_BIND)
+      return; // todo error handling
 
+    // applied by end(), the attributes are still packed after each other
+    _explicitStrides[binding] = stride;
+  }
+
+  void VertexAttributes::setStepRate(uint32_t binding, VertexStepRate stepRate) {
+    if (binding >= MAX_BUFFER_BIND)
+      return; // todo error handling
+
+    _stepRates[binding] = stepRate;
+  }
+
+  void VertexAttributes::end() {
+    for (int i = 0; i < MAX_BUFFER_BIND; i++) {
+      if (_explicitStrides[i] != 0)
+        _strides[i] = _explicitStrides[i];
+    }
   }
 }
 
@@ -5,8 +5,104 @@
 
 #include "renderer_vk.h"
 #include "renderer_gl.h"
+#include "hash.h"
 
 namespace jgfx {
+  static uint32_t getPrimitiveClass(PrimitiveType primitive) {
+    switch (primitive) {
+    case POINTS: return 0;
+    case LINES:
+    case LINE_STRIP: return 1;
+    case TRIANGLES:
+    case TRIANGLE_STRIP:
+    case TRIANGLE_FAN: return 2;
+    }
+
+    return 2;
+  }
+
+  uint64_t hashPipelineDesc(const PipelineDesc& desc, bool dynamicRasterState) {
+    Hasher hasher;
+    hasher.add(desc.program.id);
+    hasher.add(desc.pass.id);
+    if (dynamicRasterState) {
+      hasher.add(getPrimitiveClass(desc.primitive));
+    }
+    else {
+      hasher.add(desc.cullMode);
+      hasher.add(desc.faceWinding);
+      hasher.add(desc.primitive);
+    }
+
+    hasher.add(desc.depth.testEnabled);
+    hasher.add(desc.depth.writeEnabled);
+    hasher.add(desc.depth.compare);
+    hasher.add(desc.stencil.enabled);
+    for (const StencilFaceState* face : { &desc.stencil.front, &desc.stencil.back }) {
+      hasher.add(face->compare);
+      hasher.add(face->failOp);
+      hasher.add(face->depthFailOp);
+      hasher.add(face->passOp);
+    }
+    hasher.add(desc.stencil.readMask);
+    hasher.add(desc.stencil.writeMask);
+    hasher.add(desc.stencil.ref);
+    hasher.add(desc.colorWriteMask);
+
+    const VertexAttributes& attr = desc.vertexAttributes;
+    for (int i = 0; i < MAX_VERTEX_ATTRIBUTES; i++) {
+      hasher.add(attr._offsets[i]);
+      hasher.add(attr._types[i]);
+      hasher.add(attr._bindings[i]);
+    }
+    for (int i = 0; i < MAX_BUFFER_BIND; i++) {
+      hasher.add(attr._strides[i]);
+      hasher.add(attr._stepRates[i]);
+    }
+
+    return hasher.get();
+  }
+
+  bool isSameVertexAttributes(const VertexAttributes& a, const VertexAttributes& b) {
+    return memcmp(a._offsets, b._offsets, sizeof(a._offsets)) == 0
+      && memcmp(a._types, b._types, sizeof(a._types)) == 0
+      && memcmp(a._bindings, b._bindings, sizeof(a._bindings)) == 0
+      && memcmp(a._strides, b._strides, sizeof(a._strides)) == 0
+      && memcmp(a._stepRates, b._stepRates, sizeof(a._stepRates)) == 0;
+  }
+
+  static bool isSameStencilFace(const StencilFaceState& a, const StencilFaceState& b) {
+    return a.compare == b.compare
+      && a.failOp == b.failOp
+      && a.depthFailOp == b.depthFailOp
+      && a.passOp == b.passOp;
+  }
+
+  bool isSamePipelineDesc(const PipelineDesc& a, const PipelineDesc& b, bool dynamicRasterState) {
+    if (a.program.id != b.program.id || a.pass.id != b.pass.id)
+      return false;
+
+    if (dynamicRasterState) {
+      if (getPrimitiveClass(a.primitive) != getPrimitiveClass(b.primitive))
+        return false;
+    }
+    else if (a.cullMode != b.cullMode || a.faceWinding != b.faceWinding || a.primitive != b.primitive) {
+      return false;
+    }
+
+    return a.depth.testEnabled == b.depth.testEnabled
+      && a.depth.writeEnabled == b.depth.writeEnabled
+      && a.depth.compare == b.depth.compare
+      && a.stencil.enabled == b.stencil.enabled
+      && isSameStencilFace(a.stencil.front, b.stencil.front)
+      && isSameStencilFace(a.stencil.back, b.stencil.back)
+      && a.stencil.readMask == b.stencil.readMask
+      && a.stencil.writeMask == b.stencil.writeMask
+      && a.stencil.ref == b.stencil.ref
+      && a.colorWriteMask == b.colorWriteMask
+      && isSameVertexAttributes(a.vertexAttributes, b.vertexAttributes);
+  }
+
   bool ContextImpl::init(const InitInfo& initInfo) {
     if (_ctx) // already initialized
       return false;
@@ -32,15 +128,38 @@ namespace jgfx {
   }
 
   PipelineHandle ContextImpl::newPipeline(const PipelineDesc& pipelineDesc) {
+    // identical descriptions share the same pipeline
+    uint64_t key = hashPipelineDesc(pipelineDesc);
+    if (const PipelineHandle* cached = _pipelineCache.find(key, pipelineDesc, [](const PipelineDesc& a, const PipelineDesc& b) { return isSamePipelineDesc(a, b); }))
+      return *cached;
+
     CommandBuffer& cmdBuf = startCommand(CommandType::NewPipeline);
     PipelineHandle handle;
     pipelineHandleAlloc.allocate(handle);
     cmdBuf.write(handle);
     cmdBuf.write(pipelineDesc);
 
+    _pipelineCache.insert(key, pipelineDesc, handle);
+
     return handle;
   }
 
+  void ContextImpl::newDepthPrepassPipelines(const PipelineDesc& pipelineDesc, PipelineHandle* prepass, PipelineHandle* shading) {
+    PipelineDesc prepassDesc = pipelineDesc;
+    prepassDesc.depth.testEnabled = true;
+    prepassDesc.depth.writeEnabled = true;
+    prepassDesc.depth.compare = CompareFunc::LESS_EQUAL;
+    prepassDesc.colorWriteMask = 0;
+    *prepass = newPipeline(prepassDesc);
+
+    // fragments hidden by the prepass are rejected before shading
+    PipelineDesc shadingDesc = pipelineDesc;
+    shadingDesc.depth.testEnabled = true;
+    shadingDesc.depth.writeEnabled = false;
+    shadingDesc.depth.compare = CompareFunc::EQUAL;
+    *shading = newPipeline(shadingDesc);
+  }
+
   PassHandle ContextImpl::newPass(const PassDesc& passDesc) {
     CommandBuffer& cmdBuf = startCommand(CommandType::NewPass);
     PassHandle handle;
@@ -75,7 +194,47 @@ namespace jgfx {
     return handle;
   }
 
-  BufferHandle ContextImpl::newBuffer(const void* data, uint32_t size, BufferType type) {
+  ProgramHandle ContextImpl::newComputeProgram(ShaderHandle cs) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewComputeProgram);
+    ProgramHandle handle;
+    programHandleAlloc.allocate(handle);
+    cmdBuf.write(handle);
+    cmdBuf.write(cs);
+
+    return handle;
+  }
+
+  PipelineHandle ContextImpl::newComputePipeline(const ComputePipelineDesc& pipelineDesc) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewComputePipeline);
+    PipelineHandle handle;
+    pipelineHandleAlloc.allocate(handle);
+    cmdBuf.write(handle);
+    cmdBuf.write(pipelineDesc);
+
+    return handle;
+  }
+
+  void ContextImpl::newShaders(const ShaderDesc* descs, uint32_t count, ShaderHandle* handles) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewShaders);
+    cmdBuf.write(count);
+    for (uint32_t i = 0; i < count; i++) {
+      shaderHandleAlloc.allocate(handles[i]);
+      cmdBuf.write(handles[i]);
+      cmdBuf.write(descs[i]);
+    }
+  }
+
+  void ContextImpl::newPrograms(const ProgramDesc* descs, uint32_t count, ProgramHandle* handles) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewPrograms);
+    cmdBuf.write(count);
+    for (uint32_t i = 0; i < count; i++) {
+      programHandleAlloc.allocate(handles[i]);
+      cmdBuf.write(handles[i]);
+      cmdBuf.write(descs[i]);
+    }
+  }
+
+  BufferHandle ContextImpl::newBuffer(const void* data, uint32_t size, BufferType type, BufferUsage usage) {
     CommandBuffer& cmdBuf = startCommand(CommandType::NewBuffer);
     BufferHandle handle;
     bufferHandleAlloc.allocate(handle);
@@ -83,10 +242,33 @@ namespace jgfx {
     cmdBuf.write(data);
     cmdBuf.write(size);
     cmdBuf.write(type);
+    cmdBuf.write(usage);
 
     return handle;
   }
 
+  void ContextImpl::updateBuffer(BufferHandle buffer, const void* data, uint32_t size) {
+    void* copy = mapBuffer(buffer, size);
+    memcpy(copy, data, size);
+  }
+
+  void* ContextImpl::mapBuffer(BufferHandle buffer, uint32_t size) {
+    void* data = allocateFrameMemory(size);
+
+    CommandBuffer& cmdBuf = startCommand(CommandType::UpdateBuffer);
+    cmdBuf.write(buffer);
+    cmdBuf.write(data);
+    cmdBuf.write(size);
+
+    return data;
+  }
+
+  void* ContextImpl::allocateFrameMemory(uint32_t size) {
+    // one block per allocation so that previous pointers stay valid
+    _frameMemory.push_back(std::make_unique<uint8_t[]>(size));
+    return _frameMemory.back().get();
+  }
+
   UniformBufferHandle ContextImpl::newUniformBuffer(uint32_t size) {
     CommandBuffer& cmdBuf = startCommand(CommandType::NewUniformBuffer);
     UniformBufferHandle handle;
@@ -109,6 +291,68 @@ namespace jgfx {
     return handle;
   }
 
+  void ContextImpl::newAliasedImages(const TextureDesc* descs, uint32_t count, ImageHandle* handles) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewAliasedImages);
+    cmdBuf.write(count);
+    for (uint32_t i = 0; i < count; i++) {
+      imageHandleAlloc.allocate(handles[i]);
+      cmdBuf.write(handles[i]);
+      cmdBuf.write(descs[i]);
+    }
+  }
+
+  static bool isSameSamplerDesc(const SamplerDesc& a, const SamplerDesc& b) {
+    return a.minFilter == b.minFilter
+      && a.magFilter == b.magFilter
+      && a.mipmapFilter == b.mipmapFilter
+      && a.addressU == b.addressU
+      && a.addressV == b.addressV
+      && a.addressW == b.addressW
+      && a.maxAnisotropy == b.maxAnisotropy;
+  }
+
+  SamplerHandle ContextImpl::newSampler(const SamplerDesc& desc) {
+    Hasher hasher;
+    hasher.add(desc.minFilter);
+    hasher.add(desc.magFilter);
+    hasher.add(desc.mipmapFilter);
+    hasher.add(desc.addressU);
+    hasher.add(desc.addressV);
+    hasher.add(desc.addressW);
+    hasher.add(desc.maxAnisotropy);
+
+    // the number of samplers is limited, identical descriptions share the same one
+    uint64_t key = hasher.get();
+    if (const SamplerHandle* cached = _samplerCache.find(key, desc, isSameSamplerDesc))
+      return *cached;
+
+    if (samplerHandleAlloc.currentId >= MAX_SAMPLERS)
+      return SamplerHandle(); // todo error handling
+
+    CommandBuffer& cmdBuf = startCommand(CommandType::NewSampler);
+    SamplerHandle handle;
+    samplerHandleAlloc.allocate(handle);
+    cmdBuf.write(handle);
+    cmdBuf.write(desc);
+
+    _samplerCache.insert(key, desc, handle);
+
+    return handle;
+  }
+
+  bool ContextImpl::isBindless() const {
+    return _ctx->isBindless();
+  }
+
+  // descriptors of the bindless set are indexed like the backend objects
+  uint32_t ContextImpl::getBindlessIndex(ImageHandle image) const {
+    return image.id;
+  }
+
+  uint32_t ContextImpl::getBindlessIndex(BufferHandle buffer) const {
+    return buffer.id;
+  }
+
   void ContextImpl::beginDefaultPass() {
     startCommand(CommandType::BeginDefaultPass);
   }
@@ -135,28 +379,171 @@ namespace jgfx {
     cmdBuf.write(size);
   }
 
-  void ContextImpl::draw(uint32_t firstVertex, uint32_t vertexCount) {
+  void ContextImpl::setCullMode(CullMode mode) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::SetCullMode);
+    cmdBuf.write(mode);
+  }
+
+  void ContextImpl::setFaceWinding(FaceWinding faceWinding) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::SetFaceWinding);
+    cmdBuf.write(faceWinding);
+  }
+
+  void ContextImpl::setPrimitiveType(PrimitiveType primitive) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::SetPrimitiveType);
+    cmdBuf.write(primitive);
+  }
+
+  void ContextImpl::draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) {
     CommandBuffer& cmdBuf = startCommand(CommandType::Draw);
     cmdBuf.write(firstVertex);
     cmdBuf.write(vertexCount);
+    cmdBuf.write(instanceCount);
+    cmdBuf.write(firstInstance);
   }
 
-  void ContextImpl::drawIndexed(uint32_t firstIndex, uint32_t indexCount) {
+  void ContextImpl::drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) {
     CommandBuffer& cmdBuf = startCommand(CommandType::DrawIndexed);
     cmdBuf.write(firstIndex);
     cmdBuf.write(indexCount);
+    cmdBuf.write(instanceCount);
+    cmdBuf.write(firstInstance);
+    cmdBuf.write(baseVertex);
+  }
+
+  void ContextImpl::drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::DrawIndirect);
+    cmdBuf.write(buffer);
+    cmdBuf.write(offset);
+    cmdBuf.write(drawCount);
+    cmdBuf.write(countBuffer);
+    cmdBuf.write(countOffset);
+  }
+
+  void ContextImpl::drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::DrawIndexedIndirect);
+    cmdBuf.write(buffer);
+    cmdBuf.write(offset);
+    cmdBuf.write(drawCount);
+    cmdBuf.write(countBuffer);
+    cmdBuf.write(countOffset);
   }
 
   void ContextImpl::endPass() {
     startCommand(CommandType::EndPass);
   }
 
+  void ContextImpl::barrier(const ResourceBarrier* barriers, uint32_t count) {
+    if (count == 0)
+      return;
+
+    CommandBuffer& cmdBuf = startCommand(CommandType::Barrier);
+    cmdBuf.write(count);
+    for (uint32_t i = 0; i < count; i++)
+      cmdBuf.write(barriers[i]);
+  }
+
+  void ContextImpl::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::Dispatch);
+    cmdBuf.write(groupCountX);
+    cmdBuf.write(groupCountY);
+    cmdBuf.write(groupCountZ);
+  }
+
+  void ContextImpl::dispatchIndirect(BufferHandle buffer, uint32_t offset) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::DispatchIndirect);
+    cmdBuf.write(buffer);
+    cmdBuf.write(offset);
+  }
+
+  void ContextImpl::fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) {
+    CommandBuffer& cmdBuf = startCommand(CommandType::FillBuffer);
+    cmdBuf.write(buffer);
+    cmdBuf.write(offset);
+    cmdBuf.write(size);
+    cmdBuf.write(value);
+  }
+
+  CullingHandle ContextImpl::newCulling(const CullingDesc& desc) {
+    // checked before allocating so that a full table doesn't consume ids
+    if (cullingHandleAlloc.currentId >= MAX_CULLING_STAGES)
+      return CullingHandle(); // todo error handling
+    CullingHandle handle;
+    cullingHandleAlloc.allocate(handle);
+
+    // the built-in shader is shared by all the stages
+    if (_cullingPipeline.id == nullHandle) {
+      ShaderHandle shader = newShader(ShaderType::COMPUTE, CULLING_SHADER, CULLING_SHADER_SIZE);
+      ComputePipelineDesc pipelineDesc;
+      pipelineDesc.program = newComputeProgram(shader);
+      _cullingPipeline = newComputePipeline(pipelineDesc);
+
+      TextureDesc reducedDepthDesc;
+      reducedDepthDesc.width = 1;
+      reducedDepthDesc.height = 1;
+      reducedDepthDesc.format = TextureFormat::R32F;
+      reducedDepthDesc.usage = TextureUsage::STORAGE;
+      _cullingDefaultReducedDepth = newImage(nullptr, 0, reducedDepthDesc);
+    }
+
+    CullingStage& stage = _cullingStages[handle.id];
+    stage.desc = desc;
+
+    // written by the culling pass, read by indirect draws
+    stage.visibleArgs = newBuffer(nullptr, desc.objectCount * sizeof(DrawIndexedIndirectCommand), STORAGE_BUFFER, BufferUsage::STATIC);
+    stage.visibleCount = newBuffer(nullptr, sizeof(uint32_t), STORAGE_BUFFER, BufferUsage::STATIC);
+
+    return handle;
+  }
+
+  void ContextImpl::cull(CullingHandle culling, const CullingParams& params) {
+    if (!isValidCulling(culling))
+      return; // todo error handling
+    CullingStage& stage = _cullingStages[culling.id];
+
+    fillBuffer(stage.visibleCount, 0, sizeof(uint32_t), 0);
+    // without count buffer support, draws read the whole list: it is cleared so that they skip the culled objects
+    if (!_ctx->supportsDrawIndirectCount())
+      fillBuffer(stage.visibleArgs, 0, stage.desc.objectCount * sizeof(DrawIndexedIndirectCommand), 0);
+
+    // commands only reference the data, a stage may be culled several times per frame
+    CullingUniforms& uniforms = *static_cast<CullingUniforms*>(allocateFrameMemory(sizeof(CullingUniforms)));
+    extractFrustumPlanes(params.viewProj, uniforms.frustumPlanes);
+    memcpy(uniforms.prevViewProj, params.prevViewProj, sizeof(uniforms.prevViewProj));
+    uniforms.objectCount = stage.desc.objectCount;
+    uniforms.occlusion = params.reducedDepth.id != nullHandle ? 1 : 0;
+
+    Bindings bindings;
+    bindings.storageBuffers[CULLING_BOUNDS_SLOT] = stage.desc.bounds;
+    bindings.storageBuffers[CULLING_DRAW_ARGS_SLOT] = stage.desc.drawArgs;
+    bindings.storageBuffers[CULLING_VISIBLE_ARGS_SLOT] = stage.visibleArgs;
+    bindings.storageBuffers[CULLING_VISIBLE_COUNT_SLOT] = stage.visibleCount;
+    bindings.storageImages[CULLING_REDUCED_DEPTH_SLOT] = uniforms.occlusion ? params.reducedDepth : _cullingDefaultReducedDepth;
+
+    applyPipeline(_cullingPipeline);
+    applyBindings(bindings);
+    applyUniforms(ALL, &uniforms, sizeof(uniforms));
+    dispatch((stage.desc.objectCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+  }
+
+  void ContextImpl::drawCulled(CullingHandle culling) {
+    if (!isValidCulling(culling))
+      return; // todo error handling
+    const CullingStage& stage = _cullingStages[culling.id];
+    drawIndexedIndirect(stage.visibleArgs, 0, stage.desc.objectCount, stage.visibleCount, 0);
+  }
+
+  bool ContextImpl::isValidCulling(CullingHandle culling) const {
+    return culling.id != nullHandle && culling.id < cullingHandleAlloc.currentId;
+  }
+
   void ContextImpl::commitFrame() {
     if (_reset) {
       _ctx->updateResolution(_initInfo.resolution);
       _reset = false;
     }
     executeCommands();
+    _frameMemory.clear();
     _ctx->commitFrame();
   }
 
@@ -214,6 +601,46 @@ namespace jgfx {
         _ctx->newProgram(handle, vs, fs);
       }
                     break;
+      case NewComputeProgram: {
+        ProgramHandle handle;
+        _cmdBuffer.read(handle);
+        ShaderHandle cs;
+        _cmdBuffer.read(cs);
+        _ctx->newComputeProgram(handle, cs);
+      }
+        break;
+      case NewComputePipeline: {
+        PipelineHandle handle;
+        _cmdBuffer.read(handle);
+        ComputePipelineDesc desc;
+        _cmdBuffer.read(desc);
+        _ctx->newComputePipeline(handle, desc);
+      }
+        break;
+      case NewShaders: {
+        uint32_t count;
+        _cmdBuffer.read(count);
+        std::vector<ShaderHandle> handles(count);
+        std::vector<ShaderDesc> descs(count);
+        for (uint32_t i = 0; i < count; i++) {
+          _cmdBuffer.read(handles[i]);
+          _cmdBuffer.read(descs[i]);
+        }
+        _ctx->newShaders(handles.data(), descs.data(), count);
+      }
+        break;
+      case NewPrograms: {
+        uint32_t count;
+        _cmdBuffer.read(count);
+        std::vector<ProgramHandle> handles(count);
+        std::vector<ProgramDesc> descs(count);
+        for (uint32_t i = 0; i < count; i++) {
+          _cmdBuffer.read(handles[i]);
+          _cmdBuffer.read(descs[i]);
+        }
+        _ctx->newPrograms(handles.data(), descs.data(), count);
+      }
+        break;
       case NewBuffer: {
         BufferHandle handle;
         _cmdBuffer.read(handle);
@@ -223,7 +650,19 @@ namespace jgfx {
         _cmdBuffer.read(size);
         BufferType type;
         _cmdBuffer.read(type);
-        _ctx->newBuffer(handle, data, size, type);
+        BufferUsage usage;
+        _cmdBuffer.read(usage);
+        _ctx->newBuffer(handle, data, size, type, usage);
+      }
+        break;
+      case UpdateBuffer: {
+        BufferHandle handle;
+        _cmdBuffer.read(handle);
+        void* data = nullptr;
+        _cmdBuffer.read(data);
+        uint32_t size;
+        _cmdBuffer.read(size);
+        _ctx->updateBuffer(handle, data, size);
       }
         break;
       case NewUniformBuffer: {
@@ -246,6 +685,26 @@ namespace jgfx {
         _ctx->newImage(handle, data, size, desc);
       }
         break;
+      case NewAliasedImages: {
+        uint32_t count;
+        _cmdBuffer.read(count);
+        std::vector<ImageHandle> handles(count);
+        std::vector<TextureDesc> descs(count);
+        for (uint32_t i = 0; i < count; i++) {
+          _cmdBuffer.read(handles[i]);
+          _cmdBuffer.read(descs[i]);
+        }
+        _ctx->newAliasedImages(handles.data(), descs.data(), count);
+      }
+        break;
+      case NewSampler: {
+        SamplerHandle handle;
+        _cmdBuffer.read(handle);
+        SamplerDesc desc;
+        _cmdBuffer.read(desc);
+        _ctx->newSampler(handle, desc);
+      }
+        break;
       case BeginDefaultPass: {
         _ctx->beginDefaultPass();
       }
@@ -278,12 +737,34 @@ namespace jgfx {
         _ctx->applyUniforms(stage, data, size);
       }
         break;
+      case SetCullMode: {
+        CullMode mode;
+        _cmdBuffer.read(mode);
+        _ctx->setCullMode(mode);
+      }
+        break;
+      case SetFaceWinding: {
+        FaceWinding faceWinding;
+        _cmdBuffer.read(faceWinding);
+        _ctx->setFaceWinding(faceWinding);
+      }
+        break;
+      case SetPrimitiveType: {
+        PrimitiveType primitive;
+        _cmdBuffer.read(primitive);
+        _ctx->setPrimitiveType(primitive);
+      }
+        break;
       case Draw: {
         uint32_t firstVertex;
         _cmdBuffer.read(firstVertex);
         uint32_t vertexCount;
         _cmdBuffer.read(vertexCount);
-        _ctx->draw(firstVertex, vertexCount);
+        uint32_t instanceCount;
+        _cmdBuffer.read(instanceCount);
+        uint32_t firstInstance;
+        _cmdBuffer.read(firstInstance);
+        _ctx->draw(firstVertex, vertexCount, instanceCount, firstInstance);
       }
         break;
       case DrawIndexed: {
@@ -291,13 +772,76 @@ namespace jgfx {
         _cmdBuffer.read(firstIndex);
         uint32_t indexCount;
         _cmdBuffer.read(indexCount);
-        _ctx->drawIndexed(firstIndex, indexCount);
+        uint32_t instanceCount;
+        _cmdBuffer.read(instanceCount);
+        uint32_t firstInstance;
+        _cmdBuffer.read(firstInstance);
+        int32_t baseVertex;
+        _cmdBuffer.read(baseVertex);
+        _ctx->drawIndexed(firstIndex, indexCount, instanceCount, firstInstance, baseVertex);
+      }
+        break;
+      case DrawIndirect:
+      case DrawIndexedIndirect: {
+        BufferHandle buffer;
+        _cmdBuffer.read(buffer);
+        uint32_t offset;
+        _cmdBuffer.read(offset);
+        uint32_t drawCount;
+        _cmdBuffer.read(drawCount);
+        BufferHandle countBuffer;
+        _cmdBuffer.read(countBuffer);
+        uint32_t countOffset;
+        _cmdBuffer.read(countOffset);
+        if (type == DrawIndirect)
+          _ctx->drawIndirect(buffer, offset, drawCount, countBuffer, countOffset);
+        else
+          _ctx->drawIndexedIndirect(buffer, offset, drawCount, countBuffer, countOffset);
       }
         break;
       case EndPass: {
         _ctx->endPass();
       }
         break;
+      case Barrier: {
+        uint32_t count;
+        _cmdBuffer.read(count);
+        std::vector<ResourceBarrier> barriers(count);
+        for (uint32_t i = 0; i < count; i++)
+          _cmdBuffer.read(barriers[i]);
+        _ctx->barrier(barriers.data(), count);
+      }
+        break;
+      case Dispatch: {
+        uint32_t groupCountX;
+        _cmdBuffer.read(groupCountX);
+        uint32_t groupCountY;
+        _cmdBuffer.read(groupCountY);
+        uint32_t groupCountZ;
+        _cmdBuffer.read(groupCountZ);
+        _ctx->dispatch(groupCountX, groupCountY, groupCountZ);
+      }
+        break;
+      case DispatchIndirect: {
+        BufferHandle buffer;
+        _cmdBuffer.read(buffer);
+        uint32_t offset;
+        _cmdBuffer.read(offset);
+        _ctx->dispatchIndirect(buffer, offset);
+      }
+        break;
+      case FillBuffer: {
+        BufferHandle buffer;
+        _cmdBuffer.read(buffer);
+        uint32_t offset;
+        _cmdBuffer.read(offset);
+        uint32_t size;
+        _cmdBuffer.read(size);
+        uint32_t value;
+        _cmdBuffer.read(value);
+        _ctx->fillBuffer(buffer, offset, size, value);
+      }
+        break;
       case End: {
         end = true;
       }
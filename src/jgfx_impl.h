@@ -1,8 +1,11 @@
 #pragma once
 
 #include "renderer.h"
+#include "culling.h"
+#include "hash.h"
 #include "jgfx/jgfx.h"
 
+#include <algorithm>
 #include <memory>
 
 constexpr int MAX_BUFFER_COMMANDS = 4 << 10;
@@ -13,22 +16,38 @@ namespace jgfx {
     NewPass,
     NewShader,
     NewProgram,
+    NewShaders,
+    NewPrograms,
+    NewComputeProgram,
+    NewComputePipeline,
     NewBuffer,
+    UpdateBuffer,
     NewUniformBuffer,
     NewImage,
+    NewAliasedImages,
+    NewSampler,
     BeginDefaultPass,
     BeginPass,
     ApplyPipeline,
     ApplyBindings,
     ApplyUniforms,
+    SetCullMode,
+    SetFaceWinding,
+    SetPrimitiveType,
     Draw,
     DrawIndexed,
+    DrawIndirect,
+    DrawIndexedIndirect,
     EndPass,
+    Barrier,
+    Dispatch,
+    DispatchIndirect,
+    FillBuffer,
     End,
   };
 
   struct CommandBuffer {
-    uint8_t* _data;
+    uint8_t* _data = nullptr;
     uint32_t _size = 0;
     uint32_t _currentPos = 0;
 
@@ -37,22 +56,20 @@ namespace jgfx {
     }
 
     ~CommandBuffer() {
-      delete _data;
+      free(_data);
     }
 
     void resize(uint32_t size) {
-      if (!_data) {
-        _data = new uint8_t[size];
-      }
-      else {
-        realloc(_data, size);
-      }
+      uint8_t* data = static_cast<uint8_t*>(realloc(_data, size));
+      if (!data)
+        return; // todo error handling
+      _data = data;
       _size = size;
     }
 
     void write(const void* data, uint32_t size) {
       if (_currentPos + size > _size)
-        resize(_currentPos + size);
+        resize(std::max(_currentPos + size, _size * 2)); // grows geometrically
 
       memcpy(&_data[_currentPos], data, size);
       _currentPos += size;
@@ -100,22 +117,48 @@ namespace jgfx {
     PassHandle newPass(const PassDesc& passDesc);
     ShaderHandle newShader(ShaderType type, const void* binData, uint32_t size);
     ProgramHandle newProgram(ShaderHandle vs, ShaderHandle fs);
-    BufferHandle newBuffer(const void* data, uint32_t size, BufferType type);
+    ProgramHandle newComputeProgram(ShaderHandle cs);
+    PipelineHandle newComputePipeline(const ComputePipelineDesc& pipelineDesc);
+    void newDepthPrepassPipelines(const PipelineDesc& pipelineDesc, PipelineHandle* prepass, PipelineHandle* shading);
+    void newShaders(const ShaderDesc* descs, uint32_t count, ShaderHandle* handles);
+    void newPrograms(const ProgramDesc* descs, uint32_t count, ProgramHandle* handles);
+    BufferHandle newBuffer(const void* data, uint32_t size, BufferType type, BufferUsage usage);
+    void updateBuffer(BufferHandle buffer, const void* data, uint32_t size);
+    void* mapBuffer(BufferHandle buffer, uint32_t size);
+    void* allocateFrameMemory(uint32_t size);
     UniformBufferHandle newUniformBuffer(uint32_t size);
     ImageHandle newImage(const void* data, uint32_t size, const TextureDesc& desc);
+    void newAliasedImages(const TextureDesc* descs, uint32_t count, ImageHandle* handles);
+    SamplerHandle newSampler(const SamplerDesc& desc);
+    bool isBindless() const;
+    uint32_t getBindlessIndex(ImageHandle image) const;
+    uint32_t getBindlessIndex(BufferHandle buffer) const;
 
     void beginDefaultPass();
     void beginPass(PassHandle pass);
     void applyPipeline(PipelineHandle pipe);
     void applyBindings(const Bindings& bindings);
     void applyUniforms(ShaderStage stage, const void* data, uint32_t size);
-    void draw(uint32_t firstVertex, uint32_t vertexCount);
-    void drawIndexed(uint32_t firstIndex, uint32_t indexCount);
+    void setCullMode(CullMode mode);
+    void setFaceWinding(FaceWinding faceWinding);
+    void setPrimitiveType(PrimitiveType primitive);
+    void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance);
+    void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex);
+    void drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset);
+    void drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset);
     void endPass();
+    void barrier(const ResourceBarrier* barriers, uint32_t count);
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+    void dispatchIndirect(BufferHandle buffer, uint32_t offset);
+    void fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value);
+    CullingHandle newCulling(const CullingDesc& desc);
+    void cull(CullingHandle culling, const CullingParams& params);
+    void drawCulled(CullingHandle culling);
     void commitFrame();
 
     CommandBuffer& startCommand(CommandType cmdType);
     void executeCommands();
+    bool isValidCulling(CullingHandle culling) const;
 
   private:
     std::unique_ptr<RenderContext> _ctx;
@@ -124,6 +167,8 @@ namespace jgfx {
     bool _reset = false;
 
     CommandBuffer _cmdBuffer;
+    // data referenced by the commands of the frame, released once they are executed
+    std::vector<std::unique_ptr<uint8_t[]>> _frameMemory;
 
     HandleAllocator<PipelineHandle> pipelineHandleAlloc;
     HandleAllocator<PassHandle> passHandleAlloc;
@@ -133,5 +178,16 @@ namespace jgfx {
     HandleAllocator<BufferHandle> bufferHandleAlloc;
     HandleAllocator<UniformBufferHandle> uniformBufferHandleAlloc;
     HandleAllocator<ImageHandle> imageHandleAlloc;
+    HandleAllocator<SamplerHandle> samplerHandleAlloc;
+    HandleAllocator<CullingHandle> cullingHandleAlloc;
+
+    CullingStage _cullingStages[MAX_CULLING_STAGES];
+    PipelineHandle _cullingPipeline; // created with the first stage
+    ImageHandle _cullingDefaultReducedDepth; // bound when no reduced depth is given, shaders need a valid image
+
+    // pipelines already created, keyed by the hash of their description
+    HashCache<PipelineDesc, PipelineHandle> _pipelineCache;
+    // samplers already created, keyed by the hash of their description
+    HashCache<SamplerDesc, SamplerHandle> _samplerCache;
   };
 }
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace jgfx {
+  /// <summary>
+  /// Calls func(i) for each i in [0, count) on the calling thread and on worker threads
+  /// Items are picked one by one so uneven workloads stay balanced
+  /// func must not use thread affine APIs (e.g. OpenGL)
+  /// </summary>
+  template<typename Func>
+  void parallelFor(uint32_t count, Func&& func) {
+    uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), count);
+    if (threadCount <= 1) {
+      for (uint32_t i = 0; i < count; i++)
+        func(i);
+      return;
+    }
+
+    std::atomic<uint32_t> next = 0;
+    auto worker = [&]() {
+      for (uint32_t i = next++; i < count; i = next++)
+        func(i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (uint32_t i = 0; i < threadCount - 1; i++)
+      threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+}
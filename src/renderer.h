@@ -12,21 +12,77 @@ namespace jgfx {
   constexpr int MAX_FRAMEBUFFERS = 512;
   constexpr int MAX_BUFFERS = 4 << 10;
   constexpr int MAX_IMAGES = 4 << 10;
-  constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+  constexpr int MAX_SAMPLERS = 256; // samplers are shared, few distinct descriptions are expected
+  constexpr int MAX_FRAMES_IN_FLIGHT = 4; // upper bound of InitInfo::framesInFlight
+  // covers the storage and uniform offset alignments of all common hardware
+  constexpr uint32_t BUFFER_SLICE_ALIGNMENT = 256;
+
+  /// <summary>
+  /// Pipeline states that can be overridden per draw
+  /// </summary>
+  struct RasterState {
+    CullMode cullMode = FRONT;
+    FaceWinding faceWinding = CLOCKWISE;
+    PrimitiveType primitive = TRIANGLES;
+  };
+
+  /// <summary>
+  /// Hash of a pipeline description.
+  /// With dynamicRasterState, cull mode and face winding are left out and only the primitive class
+  /// (points, lines or triangles) is kept since these states are then set at draw time
+  /// </summary>
+  uint64_t hashPipelineDesc(const PipelineDesc& desc, bool dynamicRasterState = false);
+
+  /// <summary>
+  /// Compares the fields hashed by hashPipelineDesc
+  /// </summary>
+  bool isSamePipelineDesc(const PipelineDesc& a, const PipelineDesc& b, bool dynamicRasterState = false);
+  bool isSameVertexAttributes(const VertexAttributes& a, const VertexAttributes& b);
+
+  /// <summary>
+  /// Size in bytes of a vertex attribute
+  /// </summary>
+  uint32_t getSizeOf(AttribType type);
+
+  /// <summary>
+  /// Number of copies of a buffer's content kept on the GPU.
+  /// Dynamic and stream buffers get one slice per frame in flight, so that an update
+  /// never overwrites data still read by a previous frame
+  /// </summary>
+  inline uint32_t getBufferSliceCount(BufferUsage usage, uint32_t framesInFlight) {
+    return usage == BufferUsage::STATIC ? 1 : framesInFlight;
+  }
+
+  inline uint32_t getFramesInFlight(const InitInfo& initInfo) {
+    if (initInfo.framesInFlight < 1)
+      return 1;
+    return initInfo.framesInFlight < MAX_FRAMES_IN_FLIGHT ? initInfo.framesInFlight : MAX_FRAMES_IN_FLIGHT;
+  }
 
   struct RenderContext {
     virtual bool init(const InitInfo& createInfo) = 0;
     virtual void shutdown() = 0;
     virtual void updateResolution(const Resolution& resolution) = 0;
+    virtual bool isBindless() const = 0;
+    // indirect draws can read their count from a buffer, otherwise they draw the max count
+    virtual bool supportsDrawIndirectCount() const = 0;
 
     // Objects creation
     virtual void newPipeline(PipelineHandle handle, const PipelineDesc& pipelineDesc) = 0;
     virtual void newPass(PassHandle handle, const PassDesc& passDesc) = 0;
     virtual void newShader(ShaderHandle handle, ShaderType type, const void* binData, uint32_t size) = 0;
     virtual void newProgram(ProgramHandle handle, ShaderHandle vs, ShaderHandle fs) = 0;
-    virtual void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type) = 0;
+    virtual void newComputeProgram(ProgramHandle handle, ShaderHandle cs) = 0;
+    virtual void newComputePipeline(PipelineHandle handle, const ComputePipelineDesc& pipelineDesc) = 0;
+    virtual void newShaders(const ShaderHandle* handles, const ShaderDesc* descs, uint32_t count) = 0;
+    virtual void newPrograms(const ProgramHandle* handles, const ProgramDesc* descs, uint32_t count) = 0;
+    virtual void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type, BufferUsage usage) = 0;
+    // replaces the first size bytes of a dynamic or stream buffer
+    virtual void updateBuffer(BufferHandle handle, const void* data, uint32_t size) = 0;
     virtual void newUniformBuffer(UniformBufferHandle handle, uint32_t size) = 0;
     virtual void newImage(ImageHandle handle, const void* data, uint32_t size, const TextureDesc& desc) = 0;
+    virtual void newAliasedImages(const ImageHandle* handles, const TextureDesc* descs, uint32_t count) = 0;
+    virtual void newSampler(SamplerHandle handle, const SamplerDesc& desc) = 0;
 
     // cmds
     virtual void beginDefaultPass() = 0;
@@ -34,9 +90,20 @@ namespace jgfx {
     virtual void applyPipeline(PipelineHandle pipe) = 0;
     virtual void applyBindings(const Bindings& bindings) = 0;
     virtual void applyUniforms(ShaderStage stage, const void* data, uint32_t size) = 0;
-    virtual void draw(uint32_t firstVertex, uint32_t vertexCount) = 0;
-    virtual void drawIndexed(uint32_t firstIndex, uint32_t indexCount) = 0;
+    virtual void setCullMode(CullMode mode) = 0;
+    virtual void setFaceWinding(FaceWinding faceWinding) = 0;
+    virtual void setPrimitiveType(PrimitiveType primitive) = 0;
+    virtual void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) = 0;
+    virtual void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) = 0;
+    // countBuffer is null when the draw count is given by the CPU
+    virtual void drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) = 0;
+    virtual void drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) = 0;
     virtual void endPass() = 0;
+    virtual void barrier(const ResourceBarrier* barriers, uint32_t count) = 0;
+    virtual void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) = 0;
+    virtual void dispatchIndirect(BufferHandle buffer, uint32_t offset) = 0;
+    // outside of passes, size is a multiple of 4
+    virtual void fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) = 0;
     virtual void commitFrame() = 0;
   };
 }
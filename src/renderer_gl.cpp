@@ -3,8 +3,23 @@
 
 #include "jgfx/jgfx.h"
 #include "spirv_reader.h"
+#include "hash.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
 
 namespace jgfx::gl {
+  constexpr uint32_t GLSL_CACHE_VERSION = 1; // to bump when the SPIR-V to GLSL translation changes
+
+  // every way the results of a dispatch can be read afterwards
+  constexpr GLbitfield COMPUTE_WRITE_BARRIER_BITS =
+    GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT |
+    GL_UNIFORM_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+
   GLint toGLShaderType(ShaderType type) {
     switch (type) {
     case ShaderType::VERTEX: return GL_VERTEX_SHADER;
@@ -15,162 +30,1154 @@ namespace jgfx::gl {
     return -1;
   }
 
-  GLint getAttribTypeComponentsCount(AttribType type) {
+  GLenum toGLPrimitiveType(PrimitiveType type) {
+    switch (type) {
+    case POINTS: return GL_POINTS;
+    case LINES: return GL_LINES;
+    case LINE_STRIP: return GL_LINE_STRIP;
+    case TRIANGLES: return GL_TRIANGLES;
+    case TRIANGLE_STRIP: return GL_TRIANGLE_STRIP;
+    case TRIANGLE_FAN: return GL_TRIANGLE_FAN;
+    }
+
+    return GL_TRIANGLES;
+  }
+
+  GLenum toGLCompareFunc(CompareFunc func) {
+    switch (func) {
+    case CompareFunc::NEVER: return GL_NEVER;
+    case CompareFunc::LESS: return GL_LESS;
+    case CompareFunc::EQUAL: return GL_EQUAL;
+    case CompareFunc::LESS_EQUAL: return GL_LEQUAL;
+    case CompareFunc::GREATER: return GL_GREATER;
+    case CompareFunc::NOT_EQUAL: return GL_NOTEQUAL;
+    case CompareFunc::GREATER_EQUAL: return GL_GEQUAL;
+    case CompareFunc::ALWAYS: return GL_ALWAYS;
+    }
+
+    return GL_ALWAYS;
+  }
+
+  GLenum toGLStencilOp(StencilOp op) {
+    switch (op) {
+    case StencilOp::KEEP: return GL_KEEP;
+    case StencilOp::ZERO: return GL_ZERO;
+    case StencilOp::REPLACE: return GL_REPLACE;
+    case StencilOp::INCR_CLAMP: return GL_INCR;
+    case StencilOp::DECR_CLAMP: return GL_DECR;
+    case StencilOp::INVERT: return GL_INVERT;
+    case StencilOp::INCR_WRAP: return GL_INCR_WRAP;
+    case StencilOp::DECR_WRAP: return GL_DECR_WRAP;
+    }
+
+    return GL_KEEP;
+  }
+
+  // clears are affected by the write masks of the last pipeline
+  void enableAllWrites() {
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glStencilMask(0xFF);
+  }
+
+  void clientWaitSync(GLsync sync) {
+    // commands are flushed on the first try only
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(sync, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+      flags = 0;
+  }
+
+  GLenum toGLIndexType(IndexType type) {
+    switch (type) {
+    case IndexType::UINT16: return GL_UNSIGNED_SHORT;
+    case IndexType::UINT32: return GL_UNSIGNED_INT;
+    }
+
+    return GL_UNSIGNED_SHORT;
+  }
+
+  uint32_t getIndexSize(IndexType type) {
+    return type == IndexType::UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+  }
+
+  GLenum toGLInternalFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8_SRGB: return GL_SRGB8_ALPHA8;
+    case TextureFormat::RGBA8: return GL_RGBA8;
+    case TextureFormat::RGBA16F: return GL_RGBA16F;
+    case TextureFormat::RGBA32F: return GL_RGBA32F;
+    case TextureFormat::R32F: return GL_R32F;
+    case TextureFormat::D32F: return GL_DEPTH_COMPONENT32F;
+    case TextureFormat::D24S8: return GL_DEPTH24_STENCIL8;
+    }
+
+    return GL_RGBA8;
+  }
+
+  GLenum toGLFilter(Filter filter) {
+    return filter == Filter::NEAREST ? GL_NEAREST : GL_LINEAR;
+  }
+
+  GLenum toGLMinFilter(Filter minFilter, Filter mipmapFilter) {
+    if (minFilter == Filter::NEAREST)
+      return mipmapFilter == Filter::NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST_MIPMAP_LINEAR;
+    return mipmapFilter == Filter::NEAREST ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+  }
+
+  GLenum toGLAddressMode(AddressMode mode) {
+    switch (mode) {
+    case AddressMode::REPEAT: return GL_REPEAT;
+    case AddressMode::MIRRORED_REPEAT: return GL_MIRRORED_REPEAT;
+    case AddressMode::CLAMP_TO_EDGE: return GL_CLAMP_TO_EDGE;
+    case AddressMode::CLAMP_TO_BORDER: return GL_CLAMP_TO_BORDER;
+    }
+
+    return GL_REPEAT;
+  }
+
+  // format and type of the pixel data given at creation
+  void toGLPixelFormat(TextureFormat format, GLenum& pixelFormat, GLenum& pixelType) {
+    switch (format) {
+    case TextureFormat::RGBA8_SRGB:
+    case TextureFormat::RGBA8: pixelFormat = GL_RGBA; pixelType = GL_UNSIGNED_BYTE; return;
+    case TextureFormat::RGBA16F: pixelFormat = GL_RGBA; pixelType = GL_HALF_FLOAT; return;
+    case TextureFormat::RGBA32F: pixelFormat = GL_RGBA; pixelType = GL_FLOAT; return;
+    case TextureFormat::R32F: pixelFormat = GL_RED; pixelType = GL_FLOAT; return;
+    case TextureFormat::D32F: pixelFormat = GL_DEPTH_COMPONENT; pixelType = GL_FLOAT; return;
+    case TextureFormat::D24S8: pixelFormat = GL_DEPTH_STENCIL; pixelType = GL_UNSIGNED_INT_24_8; return;
+    }
+
+    pixelFormat = GL_RGBA;
+    pixelType = GL_UNSIGNED_BYTE;
+  }
+
+  /// <summary>
+  /// Vertex attribute format as expected by glVertexAttribFormat, 
+  /// integer attributes go through glVertexAttribIFormat instead
+  /// </summary>
+  struct AttribFormatGL {
+    GLint count = 0;
+    GLenum type = GL_FLOAT;
+    GLboolean normalized = GL_FALSE;
+    bool integer = false;
+  };
+
+  AttribFormatGL toGLAttribFormat(AttribType type) {
     switch (type) {
-    case AttribType::UNKNOWN: return 0;
-    case AttribType::FLOAT: return 1;
-    case AttribType::FLOAT2: return 2;
-    case AttribType::FLOAT3: return 3;
-    case AttribType::FLOAT4: return 4;
+    case AttribType::UNKNOWN: return {};
+    case AttribType::FLOAT: return { 1, GL_FLOAT };
+    case AttribType::FLOAT2: return { 2, GL_FLOAT };
+    case AttribType::FLOAT3: return { 3, GL_FLOAT };
+    case AttribType::FLOAT4: return { 4, GL_FLOAT };
+    case AttribType::HALF2: return { 2, GL_HALF_FLOAT };
+    case AttribType::HALF4: return { 4, GL_HALF_FLOAT };
+    case AttribType::BYTE4_NORM: return { 4, GL_BYTE, GL_TRUE };
+    case AttribType::UBYTE4_NORM: return { 4, GL_UNSIGNED_BYTE, GL_TRUE };
+    case AttribType::SHORT2_NORM: return { 2, GL_SHORT, GL_TRUE };
+    case AttribType::SHORT4_NORM: return { 4, GL_SHORT, GL_TRUE };
+    case AttribType::USHORT2_NORM: return { 2, GL_UNSIGNED_SHORT, GL_TRUE };
+    case AttribType::USHORT4_NORM: return { 4, GL_UNSIGNED_SHORT, GL_TRUE };
+    case AttribType::INT_10_10_10_2_NORM: return { 4, GL_INT_2_10_10_10_REV, GL_TRUE };
+    case AttribType::UINT_10_10_10_2_NORM: return { 4, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE };
+    case AttribType::UBYTE4: return { 4, GL_UNSIGNED_BYTE, GL_FALSE, true };
+    case AttribType::INT: return { 1, GL_INT, GL_FALSE, true };
+    case AttribType::INT2: return { 2, GL_INT, GL_FALSE, true };
+    case AttribType::INT3: return { 3, GL_INT, GL_FALSE, true };
+    case AttribType::INT4: return { 4, GL_INT, GL_FALSE, true };
+    case AttribType::UINT: return { 1, GL_UNSIGNED_INT, GL_FALSE, true };
+    case AttribType::UINT2: return { 2, GL_UNSIGNED_INT, GL_FALSE, true };
+    case AttribType::UINT3: return { 3, GL_UNSIGNED_INT, GL_FALSE, true };
+    case AttribType::UINT4: return { 4, GL_UNSIGNED_INT, GL_FALSE, true };
     }
 
-    return 0;
+    return {};
   }
 
   bool RenderContextGL::init(const InitInfo& createInfo) {
-    glGenVertexArrays(1, &_vao);
+    _resolution = createInfo.resolution;
+
+    _shaderCache.init(createInfo.shaderCacheDir);
+
+    GLint binaryFormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+    _programBinarySupported = binaryFormatCount > 0;
+
+    Hasher hasher;
+    const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : driverStrings) {
+      const char* str = reinterpret_cast<const char*>(glGetString(name));
+      if (str)
+        hasher.add(str, strlen(str));
+    }
+    _driverHash = hasher.get();
+
+    // let the driver compile and link on its own threads
+    _parallelShaderCompile = GLAD_GL_KHR_parallel_shader_compile != 0;
+    if (_parallelShaderCompile)
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+    _bufferStorage = GLAD_GL_ARB_buffer_storage != 0;
+    _multiBind = GLAD_GL_ARB_multi_bind != 0;
+
+    _directStateAccess = GLAD_GL_ARB_direct_state_access != 0;
+    glGenBuffers(1, &_unpackBuffer);
+
+    if (GLAD_GL_EXT_texture_filter_anisotropic)
+      glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &_maxAnisotropy);
+    if (!_defaultSampler.create(SamplerDesc(), _maxAnisotropy))
+      return false;
+
+    // the present mode is left to the window, which owns the swap interval
+    _framesInFlight = getFramesInFlight(createInfo);
+    _lowLatency = createInfo.lowLatency;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+      _uniformAlignment = alignment;
+
+    createUniformRing(UNIFORM_RING_FRAME_SIZE);
 
     return true;
   }
 
+  void RenderContextGL::createUniformRing(uint32_t frameSize) {
+    // the previous buffer is only deleted by GL once the draws using it are done
+    if (_uniformBuffer != 0)
+      glDeleteBuffers(1, &_uniformBuffer);
+
+    // the region of a frame is written again once its fence is signaled
+    glGenBuffers(1, &_uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, _uniformBuffer);
+    const uint32_t uniformBufferSize = frameSize * _framesInFlight;
+    if (_bufferStorage) {
+      const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_UNIFORM_BUFFER, uniformBufferSize, nullptr, flags);
+      _uniformMapped = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, uniformBufferSize, flags));
+    }
+    else {
+      glBufferData(GL_UNIFORM_BUFFER, uniformBufferSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    _uniformFrameSize = frameSize;
+    _uniformOffset = 0;
+  }
+
   void RenderContextGL::shutdown() {
     glBindVertexArray(0);
-    glDeleteVertexArrays(1, &_vao);
+    for (auto& [key, entry] : _vertexArrays._entries) {
+      entry.second.destroy();
+    }
+    _vertexArrays.clear();
+    _currentVertexArray = nullptr;
+    // deleting the buffer also unmaps it
+    glDeleteBuffers(1, &_uniformBuffer);
+    _uniformMapped = nullptr;
+    glDeleteBuffers(1, &_unpackBuffer);
+    for (auto& [id, frame] : _retiredBuffers) {
+      glDeleteBuffers(1, &id);
+    }
+    _retiredBuffers.clear();
+    for (PassGL& pass : _passes) {
+      pass.destroy();
+    }
+    for (SamplerGL& sampler : _samplers) {
+      sampler.destroy();
+    }
+    _defaultSampler.destroy();
+    for (GLsync& fence : _frameFences) {
+      if (fence)
+        glDeleteSync(fence);
+      fence = nullptr;
+    }
   }
 
   void RenderContextGL::updateResolution(const Resolution& resolution) {
+    _resolution = resolution;
     glViewport(0, 0, resolution.width, resolution.height);
   }
 
+  bool RenderContextGL::isBindless() const {
+    return false; // descriptor sets are Vulkan only
+  }
+
+  bool RenderContextGL::supportsDrawIndirectCount() const {
+    return GLAD_GL_ARB_indirect_parameters != 0;
+  }
+
   void RenderContextGL::newPipeline(PipelineHandle handle, const PipelineDesc& pipelineDesc) {
     _pipelines[handle.id].create(pipelineDesc);
   }
 
   void RenderContextGL::newPass(PassHandle handle, const PassDesc& passDesc) {
-
+    _passes[handle.id].create(passDesc, _textures);
   }
 
   void RenderContextGL::newShader(ShaderHandle handle, ShaderType type, const void* binData, uint32_t size) {
-    _shaders[handle.id].create(type, size, binData);
+    _shaders[handle.id].create(type, size, binData, _shaderCache);
   }
 
   void RenderContextGL::newProgram(ProgramHandle handle, ShaderHandle vsHandle, ShaderHandle fsHandle) {
-    _programs[handle.id].create(_shaders[vsHandle.id], _shaders[fsHandle.id]);
+    ShaderHandle handles[] = { vsHandle, fsHandle };
+    ShaderGL* shaders[] = { &_shaders[vsHandle.id], &_shaders[fsHandle.id] };
+    _programs[handle.id].create(shaders, 2, getBinaryCache(), getProgramKey(handles, 2));
   }
 
-  void RenderContextGL::newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type) {
-    _buffers[handle.id].create(size, data);
+  void RenderContextGL::newComputeProgram(ProgramHandle handle, ShaderHandle cs) {
+    ShaderGL* shader = &_shaders[cs.id];
+    _programs[handle.id].create(&shader, 1, getBinaryCache(), getProgramKey(&cs, 1));
   }
 
-  void RenderContextGL::newUniformBuffer(UniformBufferHandle handle, uint32_t size) {
+  void RenderContextGL::newComputePipeline(PipelineHandle handle, const ComputePipelineDesc& pipelineDesc) {
+    _pipelines[handle.id].createCompute(pipelineDesc);
+  }
+
+  void RenderContextGL::newShaders(const ShaderHandle* handles, const ShaderDesc* descs, uint32_t count) {
+    // translation to GLSL doesn't touch the GL context, drivers compile later when programs are linked
+    parallelFor(count, [&](uint32_t i) {
+      _shaders[handles[i].id].create(descs[i].type, descs[i].size, descs[i].binData, _shaderCache);
+    });
+  }
+
+  void RenderContextGL::newPrograms(const ProgramHandle* handles, const ProgramDesc* descs, uint32_t count) {
+    const ShaderCache* binaryCache = getBinaryCache();
+
+    // submit every compilation and link before querying any status so that they overlap
+    std::vector<uint32_t> pending;
+    pending.reserve(count);
+    std::vector<uint64_t> keys(count);
+    for (uint32_t i = 0; i < count; i++) {
+      ShaderHandle shaderHandles[] = { descs[i].vs, descs[i].fs };
+      ShaderGL* shaders[] = { &_shaders[descs[i].vs.id], &_shaders[descs[i].fs.id] };
+      keys[i] = getProgramKey(shaderHandles, 2);
+      if (_programs[handles[i].id].link(shaders, 2, binaryCache, keys[i]))
+        pending.push_back(i);
+    }
+
+    // finish programs as soon as the driver is done with them
+    // each pass polls every pending program once, the thread yields to the driver between passes
+    while (!pending.empty()) {
+      for (size_t j = 0; j < pending.size();) {
+        uint32_t i = pending[j];
+        ProgramGL& program = _programs[handles[i].id];
+        if (!program.isLinkCompleted(_parallelShaderCompile)) {
+          j++;
+          continue;
+        }
 
+        program.finishLink(binaryCache, keys[i]);
+        pending[j] = pending.back();
+        pending.pop_back();
+      }
+
+      if (!pending.empty())
+        std::this_thread::yield();
+    }
+  }
+
+  const ShaderCache* RenderContextGL::getBinaryCache() const {
+    return _programBinarySupported && _shaderCache.isEnabled() ? &_shaderCache : nullptr;
+  }
+
+  uint64_t RenderContextGL::getProgramKey(const ShaderHandle* shaders, uint32_t shaderCount) const {
+    Hasher hasher;
+    hasher.add(_driverHash);
+    for (uint32_t i = 0; i < shaderCount; i++) {
+      hasher.add(_shaders[shaders[i].id]._hash);
+    }
+    return hasher.get();
+  }
+
+  void RenderContextGL::newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type, BufferUsage usage) {
+    _buffers[handle.id].create(size, data, usage, _framesInFlight, _bufferStorage);
+  }
+
+  void RenderContextGL::updateBuffer(BufferHandle handle, const void* data, uint32_t size) {
+    BufferGL& buffer = _buffers[handle.id];
+
+    // glBufferSubData is synchronized by the driver, mapped writes are not. Updated more than once per frame,
+    // the next slice may still be read by a frame in flight, or even by the commands of this one. Rather than
+    // waiting mid-frame, the buffer gets more slices until it has enough
+    if (!buffer._sliceFrames.empty()) {
+      // the commands recorded so far read the current slice
+      buffer._sliceFrames[buffer._activeSlice] = _frameNumber;
+
+      uint64_t nextFrame = buffer._sliceFrames[(buffer._activeSlice + 1) % buffer._sliceCount];
+      if (nextFrame != 0 && nextFrame + _framesInFlight > _frameNumber) {
+        unsigned int previousId;
+        if (!buffer.grow(previousId))
+          return; // todo error handling, the content is left untouched
+        // the applied bindings keep reading the previous buffer, it is deleted once its last frame is done
+        _retiredBuffers.push_back({ previousId, _frameNumber });
+      }
+    }
+    buffer.update(data, size);
+  }
+
+  void RenderContextGL::newUniformBuffer(UniformBufferHandle handle, uint32_t size) {
+    // applyUniforms data goes through the uniform ring, nothing to create
   }
 
   void RenderContextGL::newImage(ImageHandle handle, const void* data, uint32_t size, const TextureDesc& desc) {
-    _textures[handle.id].create();
+    _textures[handle.id].create(desc, data, size, _directStateAccess, _unpackBuffer);
+  }
+
+  void RenderContextGL::newAliasedImages(const ImageHandle* handles, const TextureDesc* descs, uint32_t count) {
+    // textures can't share memory
+    for (uint32_t i = 0; i < count; i++)
+      newImage(handles[i], nullptr, 0, descs[i]);
+  }
+
+  void RenderContextGL::newSampler(SamplerHandle handle, const SamplerDesc& desc) {
+    _samplers[handle.id].create(desc, _maxAnisotropy);
   }
 
   void RenderContextGL::beginDefaultPass() {
+    _currentPass = PassHandle();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, _resolution.width, _resolution.height);
+    enableAllWrites();
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    glClearDepth(1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   }
 
   void RenderContextGL::beginPass(PassHandle pass) {
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    _currentPass = pass;
+    _passes[pass.id].begin();
   }
 
   void RenderContextGL::applyPipeline(PipelineHandle pipe) {
     const PipelineGL& pipeline = _pipelines[pipe.id];
     ProgramGL& program = _programs[pipeline._desc.program.id];
     program.use();
-    //glBindVertexArray(_vao);
-    program.bindAttributes(pipeline._desc.vertexAttributes);
+    if (pipeline._compute)
+      return;
+
+    // pipelines with the same vertex layout share their vertex array, formats are never specified again
+    const VertexAttributes& attr = pipeline._desc.vertexAttributes;
+    Hasher hasher;
+    hasher.add(attr._offsets);
+    hasher.add(attr._types);
+    hasher.add(attr._bindings);
+    hasher.add(attr._strides);
+    hasher.add(attr._stepRates);
+    VertexArrayGL* vertexArray = _vertexArrays.find(hasher.get(), attr, isSameVertexAttributes);
+    VertexArrayGL* previousVertexArray = _currentVertexArray;
+    if (!vertexArray) {
+      vertexArray = &_vertexArrays.insert(hasher.get(), attr, VertexArrayGL());
+      vertexArray->create(attr);
+      _currentVertexArray = vertexArray; // bound by the creation
+    }
+    if (_currentVertexArray != vertexArray) {
+      glBindVertexArray(vertexArray->_id);
+      _currentVertexArray = vertexArray;
+    }
+    memcpy(_vertexStrides, attr._strides, sizeof(_vertexStrides));
+
+    // vertex and index buffers are vertex array state, they carry over pipeline switches like in Vulkan
+    if (_currentVertexArray != previousVertexArray)
+      applyVertexBindings(_currentBindings);
+
+    setCullMode(pipeline._desc.cullMode);
+    setFaceWinding(pipeline._desc.faceWinding);
+    setPrimitiveType(pipeline._desc.primitive);
+    applyDepthStencilState(pipeline._desc);
+  }
+
+  void RenderContextGL::applyDepthStencilState(const PipelineDesc& desc) {
+    // without depth buffer, the depth test always passes
+    const DepthState& depth = desc.depth;
+    if (depth.testEnabled) {
+      glEnable(GL_DEPTH_TEST);
+      glDepthFunc(toGLCompareFunc(depth.compare));
+    }
+    else {
+      glDisable(GL_DEPTH_TEST);
+    }
+    glDepthMask(depth.testEnabled && depth.writeEnabled ? GL_TRUE : GL_FALSE);
+
+    const StencilState& stencil = desc.stencil;
+    if (stencil.enabled) {
+      glEnable(GL_STENCIL_TEST);
+      const GLenum faces[] = { GL_FRONT, GL_BACK };
+      const StencilFaceState* faceStates[] = { &stencil.front, &stencil.back };
+      for (uint32_t i = 0; i < 2; i++) {
+        glStencilFuncSeparate(faces[i], toGLCompareFunc(faceStates[i]->compare), stencil.ref, stencil.readMask);
+        glStencilOpSeparate(faces[i], toGLStencilOp(faceStates[i]->failOp), toGLStencilOp(faceStates[i]->depthFailOp), toGLStencilOp(faceStates[i]->passOp));
+      }
+      glStencilMask(stencil.writeMask);
+    }
+    else {
+      glDisable(GL_STENCIL_TEST);
+    }
+
+    const uint8_t mask = desc.colorWriteMask;
+    glColorMask((mask & 1) != 0, (mask & 2) != 0, (mask & 4) != 0, (mask & 8) != 0);
   }
 
   void RenderContextGL::applyBindings(const Bindings& bindings) {
-    const BufferGL& vb = _buffers[bindings.vertexBuffers[0].id];
-    const BufferGL& ib = _buffers[bindings.indexBuffer.id];
-    glBindVertexArray(_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vb._id);
-    //glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib._id);
+    _currentBindings = bindings;
+    applyVertexBindings(bindings);
+
+    // storage slots match the binding points of the shaders
+    for (uint32_t i = 0; i < MAX_STORAGE_BIND; i++) {
+      if (bindings.storageBuffers[i].id != nullHandle) {
+        const BufferGL& buffer = _buffers[bindings.storageBuffers[i].id];
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, i, buffer._id, buffer.getOffset(), buffer._sliceSize);
+      }
+
+      if (bindings.storageImages[i].id != nullHandle) {
+        const TextureGL& texture = _textures[bindings.storageImages[i].id];
+        glBindImageTexture(i, texture._id, 0, GL_FALSE, 0, GL_READ_WRITE, texture._internalFormat);
+      }
+    }
+
+    // image slot i is texture unit i, the sampler object overrides the parameters of the texture
+    for (uint32_t i = 0; i < MAX_IMAGE_BIND; i++) {
+      if (bindings.images[i].id == nullHandle)
+        continue;
+
+      const TextureGL& texture = _textures[bindings.images[i].id];
+      if (_directStateAccess) {
+        glBindTextureUnit(i, texture._id);
+      }
+      else {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(texture._target, texture._id);
+      }
+      const SamplerGL& sampler = bindings.samplers[i].id != nullHandle ? _samplers[bindings.samplers[i].id] : _defaultSampler;
+      glBindSampler(i, sampler._id);
+    }
+  }
+
+  void RenderContextGL::applyVertexBindings(const Bindings& bindings) {
+    _indexType = bindings.indexType;
+    _indexBufferOffset = bindings.indexBufferOffset;
+    if (_currentVertexArray) {
+      VertexArrayGL& vertexArray = *_currentVertexArray;
+
+      // only the range of slots differing from the buffers already bound to the vertex array is bound
+      GLuint buffers[MAX_BUFFER_BIND];
+      GLintptr offsets[MAX_BUFFER_BIND];
+      GLsizei strides[MAX_BUFFER_BIND];
+      uint32_t first = MAX_BUFFER_BIND;
+      uint32_t last = 0;
+      for (uint32_t i = 0; i < MAX_BUFFER_BIND; i++) {
+        buffers[i] = vertexArray._vertexBuffers[i];
+        offsets[i] = vertexArray._vertexBufferOffsets[i];
+        strides[i] = _vertexStrides[i];
+        if (bindings.vertexBuffers[i].id == nullHandle || _vertexStrides[i] == 0)
+          continue;
+
+        const BufferGL& buffer = _buffers[bindings.vertexBuffers[i].id];
+        buffers[i] = buffer._id;
+        offsets[i] = buffer.getOffset() + bindings.vertexBufferOffsets[i];
+        if (buffers[i] != vertexArray._vertexBuffers[i] || offsets[i] != vertexArray._vertexBufferOffsets[i]) {
+          first = std::min(first, i);
+          last = std::max(last, i);
+        }
+      }
+
+      if (first <= last) {
+        if (_multiBind) {
+          glBindVertexBuffers(first, last - first + 1, &buffers[first], &offsets[first], &strides[first]);
+        }
+        else {
+          for (uint32_t i = first; i <= last; i++)
+            glBindVertexBuffer(i, buffers[i], offsets[i], strides[i]);
+        }
+        for (uint32_t i = first; i <= last; i++) {
+          vertexArray._vertexBuffers[i] = buffers[i];
+          vertexArray._vertexBufferOffsets[i] = offsets[i];
+        }
+      }
+
+      // the element buffer binding is part of the vertex array state
+      if (bindings.indexBuffer.id != nullHandle) {
+        const BufferGL& buffer = _buffers[bindings.indexBuffer.id];
+        if (vertexArray._indexBuffer != buffer._id) {
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer._id);
+          vertexArray._indexBuffer = buffer._id;
+        }
+        _indexBufferOffset += buffer.getOffset();
+      }
+    }
   }
 
   void RenderContextGL::applyUniforms(ShaderStage stage, const void* data, uint32_t size) {
+    if (size > UNIFORM_BUFFER_SIZE)
+      return; // todo error handling
+
+    // each call gets its own range so that previous draws keep their data
+    uint32_t offset = (_uniformOffset + _uniformAlignment - 1) / _uniformAlignment * _uniformAlignment;
+    if (offset + size > _uniformFrameSize) {
+      // the frame continues at the start of a larger buffer, draws recorded before keep the previous one
+      createUniformRing(std::max(_uniformFrameSize * 2, size));
+      offset = 0;
+    }
+    _uniformOffset = offset + size;
+    offset += _frameIndex * _uniformFrameSize;
 
+    // the GPU is done with the region of this frame, no synchronization needed
+    if (_uniformMapped) {
+      memcpy(_uniformMapped + offset, data, size);
+    }
+    else {
+      glBindBuffer(GL_UNIFORM_BUFFER, _uniformBuffer);
+      glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, _uniformBuffer, offset, size);
+  }
+
+  void RenderContextGL::setCullMode(CullMode mode) {
+    // cull mode, face winding and primitive are always dynamic in GL
+    switch (mode) {
+    case NONE: glDisable(GL_CULL_FACE); break;
+    case FRONT: glEnable(GL_CULL_FACE); glCullFace(GL_FRONT); break;
+    case BACK: glEnable(GL_CULL_FACE); glCullFace(GL_BACK); break;
+    }
+  }
+
+  void RenderContextGL::setFaceWinding(FaceWinding faceWinding) {
+    glFrontFace(faceWinding == CLOCKWISE ? GL_CW : GL_CCW);
+  }
+
+  void RenderContextGL::setPrimitiveType(PrimitiveType primitive) {
+    _primitive = primitive;
+  }
+
+  void RenderContextGL::draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) {
+    glDrawArraysInstancedBaseInstance(toGLPrimitiveType(_primitive), firstVertex, vertexCount, instanceCount, firstInstance);
   }
 
-  void RenderContextGL::draw(uint32_t firstVertex, uint32_t vertexCount) {
-    glDrawArrays(GL_TRIANGLES, firstVertex, vertexCount);
+  void RenderContextGL::drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) {
+    uintptr_t offset = _indexBufferOffset + firstIndex * getIndexSize(_indexType);
+    glDrawElementsInstancedBaseVertexBaseInstance(
+      toGLPrimitiveType(_primitive),
+      indexCount,
+      toGLIndexType(_indexType),
+      reinterpret_cast<const void*>(offset),
+      instanceCount,
+      baseVertex,
+      firstInstance
+    );
   }
 
-  void RenderContextGL::drawIndexed(uint32_t firstIndex, uint32_t indexCount) {
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+  void RenderContextGL::drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    const BufferGL& argsBuffer = _buffers[buffer.id];
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argsBuffer._id);
+    const void* indirect = reinterpret_cast<const void*>(static_cast<uintptr_t>(argsBuffer.getOffset() + offset));
+
+    if (countBuffer.id != nullHandle && GLAD_GL_ARB_indirect_parameters) {
+      const BufferGL& count = _buffers[countBuffer.id];
+      glBindBuffer(GL_PARAMETER_BUFFER_ARB, count._id);
+      glMultiDrawArraysIndirectCountARB(toGLPrimitiveType(_primitive), indirect, count.getOffset() + countOffset, drawCount, 0);
+      return;
+    }
+
+    // without count support, the max draw count is used: unused arguments must have an instance count of 0
+    glMultiDrawArraysIndirect(toGLPrimitiveType(_primitive), indirect, drawCount, 0);
+  }
+
+  void RenderContextGL::drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    // GL has no index buffer offset for indirect draws, indices are read from the start of the buffer.
+    // For the same reason dynamic index buffers would always read their first slice
+    if (_currentBindings.indexBufferOffset != 0 || _buffers[_currentBindings.indexBuffer.id]._sliceCount > 1)
+      return; // todo error handling
+
+    const BufferGL& argsBuffer = _buffers[buffer.id];
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argsBuffer._id);
+    const void* indirect = reinterpret_cast<const void*>(static_cast<uintptr_t>(argsBuffer.getOffset() + offset));
+
+    if (countBuffer.id != nullHandle && GLAD_GL_ARB_indirect_parameters) {
+      const BufferGL& count = _buffers[countBuffer.id];
+      glBindBuffer(GL_PARAMETER_BUFFER_ARB, count._id);
+      glMultiDrawElementsIndirectCountARB(toGLPrimitiveType(_primitive), toGLIndexType(_indexType), indirect, count.getOffset() + countOffset, drawCount, 0);
+      return;
+    }
+
+    glMultiDrawElementsIndirect(toGLPrimitiveType(_primitive), toGLIndexType(_indexType), indirect, drawCount, 0);
   }
 
   void RenderContextGL::endPass() {
+    if (_currentPass.id == nullHandle)
+      return;
+
+    _passes[_currentPass.id].end();
+    _currentPass = PassHandle();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, _resolution.width, _resolution.height);
+  }
+
+  void RenderContextGL::barrier(const ResourceBarrier* barriers, uint32_t count) {
+    // only incoherent shader writes need a barrier, other hazards are handled by the driver
+    GLbitfield bits = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (barriers[i].before != ResourceState::SHADER_WRITE)
+        continue;
+
+      switch (barriers[i].after) {
+      case ResourceState::SHADER_READ:
+      case ResourceState::SHADER_WRITE: bits |= COMPUTE_WRITE_BARRIER_BITS; break;
+      case ResourceState::COLOR_ATTACHMENT:
+      case ResourceState::DEPTH_ATTACHMENT: bits |= GL_FRAMEBUFFER_BARRIER_BIT; break;
+      default: break;
+      }
+    }
+
+    if (bits != 0)
+      glMemoryBarrier(bits);
+  }
+
+  void RenderContextGL::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    glDispatchCompute(groupCountX, groupCountY, groupCountZ);
+    glMemoryBarrier(COMPUTE_WRITE_BARRIER_BITS);
+  }
 
+  void RenderContextGL::dispatchIndirect(BufferHandle buffer, uint32_t offset) {
+    const BufferGL& argsBuffer = _buffers[buffer.id];
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, argsBuffer._id);
+    glDispatchComputeIndirect(argsBuffer.getOffset() + offset);
+    glMemoryBarrier(COMPUTE_WRITE_BARRIER_BITS);
+  }
+
+  void RenderContextGL::fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) {
+    const BufferGL& target = _buffers[buffer.id];
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target._id);
+    glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, target.getOffset() + offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
   }
 
   void RenderContextGL::commitFrame() {
+    GLsync& fence = _frameFences[_frameIndex];
+    if (fence)
+      glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
+    // before recording the next frame, make sure the GPU is done with the one that used the same buffer slices
+    uint32_t previousFrame = (_frameIndex + _framesInFlight - 1) % _framesInFlight;
+    _frameIndex = (_frameIndex + 1) % _framesInFlight;
+    GLsync& nextFence = _frameFences[_frameIndex];
+    if (nextFence) {
+      clientWaitSync(nextFence);
+      glDeleteSync(nextFence);
+      nextFence = nullptr;
+    }
+    _uniformOffset = 0;
+    _frameNumber++;
+
+    // a deleted name can be reused by a new buffer, the cached vertex array bindings must not match it
+    for (size_t i = 0; i < _retiredBuffers.size();) {
+      if (_retiredBuffers[i].second + _framesInFlight > _frameNumber) {
+        i++;
+        continue;
+      }
+      unsigned int id = _retiredBuffers[i].first;
+      for (auto& [key, entry] : _vertexArrays._entries) {
+        VertexArrayGL& vertexArray = entry.second;
+        for (uint32_t j = 0; j < MAX_BUFFER_BIND; j++) {
+          if (vertexArray._vertexBuffers[j] == id)
+            vertexArray._vertexBuffers[j] = 0;
+        }
+        if (vertexArray._indexBuffer == id)
+          vertexArray._indexBuffer = 0;
+      }
+      glDeleteBuffers(1, &id);
+      _retiredBuffers[i] = _retiredBuffers.back();
+      _retiredBuffers.pop_back();
+    }
+
+    // the buffers are swapped by the window, the previous frame being done is the closest to its presentation
+    if (_lowLatency && _frameFences[previousFrame])
+      clientWaitSync(_frameFences[previousFrame]);
   }
 
-  bool TextureGL::create() {
-    return false;
+  bool TextureGL::create(const TextureDesc& desc, const void* data, uint32_t size, bool directStateAccess, unsigned int unpackBuffer) {
+    _internalFormat = toGLInternalFormat(desc.format);
+    _width = desc.width;
+    _height = desc.height;
+    _target = desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+
+    // a full chain goes down to 1x1
+    _levels = 1;
+    if (desc.mipmaps && desc.samples == 1) {
+      while ((std::max(desc.width, desc.height) >> _levels) > 0)
+        _levels++;
+    }
+
+    // immutable storage, required to bind the texture as a storage image
+    if (directStateAccess) {
+      glCreateTextures(_target, 1, &_id);
+      if (desc.samples > 1)
+        glTextureStorage2DMultisample(_id, desc.samples, _internalFormat, desc.width, desc.height, GL_TRUE);
+      else
+        glTextureStorage2D(_id, _levels, _internalFormat, desc.width, desc.height);
+    }
+    else {
+      glGenTextures(1, &_id);
+      glBindTexture(_target, _id);
+      if (desc.samples > 1)
+        glTexStorage2DMultisample(_target, desc.samples, _internalFormat, desc.width, desc.height, GL_TRUE);
+      else
+        glTexStorage2D(_target, _levels, _internalFormat, desc.width, desc.height);
+    }
+
+    // multisampled textures are render targets only, resolved into single sampled ones
+    if (data && desc.samples == 1) {
+      GLenum pixelFormat, pixelType;
+      toGLPixelFormat(desc.format, pixelFormat, pixelType);
+
+      // with an unpack buffer bound, pixels is an offset into it
+      const void* pixels = data;
+      if (unpackBuffer != 0 && size > 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+        // new storage, uploads still read by the GPU keep the previous one
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+          memcpy(mapped, data, size);
+          glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+          pixels = nullptr;
+        }
+        else {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+      }
+
+      if (directStateAccess)
+        glTextureSubImage2D(_id, 0, 0, 0, desc.width, desc.height, pixelFormat, pixelType, pixels);
+      else
+        glTexSubImage2D(_target, 0, 0, 0, desc.width, desc.height, pixelFormat, pixelType, pixels);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      if (_levels > 1) {
+        if (directStateAccess)
+          glGenerateTextureMipmap(_id);
+        else
+          glGenerateMipmap(_target);
+      }
+    }
+
+    if (!directStateAccess)
+      glBindTexture(_target, 0);
+
+    return _id != 0;
   }
 
   void TextureGL::destroy() {
+    if (_id != 0)
+      glDeleteTextures(1, &_id);
+  }
+
+  bool SamplerGL::create(const SamplerDesc& desc, float maxAnisotropy) {
+    glGenSamplers(1, &_id);
+    glSamplerParameteri(_id, GL_TEXTURE_MIN_FILTER, toGLMinFilter(desc.minFilter, desc.mipmapFilter));
+    glSamplerParameteri(_id, GL_TEXTURE_MAG_FILTER, toGLFilter(desc.magFilter));
+    glSamplerParameteri(_id, GL_TEXTURE_WRAP_S, toGLAddressMode(desc.addressU));
+    glSamplerParameteri(_id, GL_TEXTURE_WRAP_T, toGLAddressMode(desc.addressV));
+    glSamplerParameteri(_id, GL_TEXTURE_WRAP_R, toGLAddressMode(desc.addressW));
+    const float borderColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    glSamplerParameterfv(_id, GL_TEXTURE_BORDER_COLOR, borderColor);
+    if (maxAnisotropy > 1.0f)
+      glSamplerParameterf(_id, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::clamp(desc.maxAnisotropy, 1.0f, maxAnisotropy));
+
+    return _id != 0;
+  }
+
+  void SamplerGL::destroy() {
+    if (_id != 0)
+      glDeleteSamplers(1, &_id);
+    _id = 0;
   }
 
   bool FramebufferGL::create() {
-    return false;
+    glGenFramebuffers(1, &_id);
+    return _id != 0;
   }
 
   void FramebufferGL::destroy() {
+    if (_id != 0)
+      glDeleteFramebuffers(1, &_id);
+    _id = 0;
+  }
+
+  bool PassGL::create(const PassDesc& desc, const TextureGL* textures) {
+    _desc = desc;
+    _colorAttachmentCount = 0;
+    if (!_framebuffer.create())
+      return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer._id);
+    GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+    for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+      if (desc.colorAttachments[i].image.id == nullHandle)
+        break;
+
+      const TextureGL& texture = textures[desc.colorAttachments[i].image.id];
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, texture._target, texture._id, 0);
+      drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+      _width = texture._width;
+      _height = texture._height;
+      _colorAttachmentCount++;
+    }
+    glDrawBuffers(_colorAttachmentCount, drawBuffers);
+    if (_colorAttachmentCount == 0)
+      glReadBuffer(GL_NONE); // depth only pass
+
+    if (desc.depthAttachment.image.id != nullHandle) {
+      const TextureGL& texture = textures[desc.depthAttachment.image.id];
+      GLenum attachment = texture._internalFormat == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+      glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, texture._target, texture._id, 0);
+      _width = texture._width;
+      _height = texture._height;
+    }
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    // resolve attachments get their own framebuffer, blitted into at the end of the pass
+    for (uint32_t i = 0; i < _colorAttachmentCount && complete; i++) {
+      if (desc.resolveAttachments[i].id == nullHandle)
+        continue;
+
+      if (_resolveFramebuffer._id == 0) {
+        _resolveFramebuffer.create();
+        glBindFramebuffer(GL_FRAMEBUFFER, _resolveFramebuffer._id);
+      }
+      const TextureGL& texture = textures[desc.resolveAttachments[i].id];
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, texture._target, texture._id, 0);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return complete; // todo error handling
   }
 
-  bool ShaderGL::create(ShaderType type, uint32_t size, const void* data) {
-    std::string srcString = read(data, size);
-    const char* src = srcString.c_str();
+  void PassGL::begin() {
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer._id);
+    glViewport(0, 0, _width, _height);
+
+    enableAllWrites();
+    GLenum discarded[MAX_COLOR_ATTACHMENTS + 1];
+    GLsizei discardedCount = 0;
+    for (uint32_t i = 0; i < _colorAttachmentCount; i++) {
+      const AttachmentDesc& color = _desc.colorAttachments[i];
+      if (color.loadOp == LoadOp::CLEAR)
+        glClearBufferfv(GL_COLOR, i, color.clearColor);
+      else if (color.loadOp == LoadOp::DONT_CARE)
+        discarded[discardedCount++] = GL_COLOR_ATTACHMENT0 + i;
+    }
+
+    const AttachmentDesc& depth = _desc.depthAttachment;
+    if (depth.image.id != nullHandle) {
+      if (depth.loadOp == LoadOp::CLEAR)
+        glClearBufferfi(GL_DEPTH_STENCIL, 0, depth.clearDepth, depth.clearStencil);
+      else if (depth.loadOp == LoadOp::DONT_CARE)
+        discarded[discardedCount++] = GL_DEPTH_STENCIL_ATTACHMENT;
+    }
 
-    _id = glCreateShader(toGLShaderType(type));
+    if (discardedCount > 0)
+      glInvalidateFramebuffer(GL_FRAMEBUFFER, discardedCount, discarded);
+  }
+
+  void PassGL::end() {
+    if (_resolveFramebuffer._id != 0) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer._id);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _resolveFramebuffer._id);
+      for (uint32_t i = 0; i < _colorAttachmentCount; i++) {
+        if (_desc.resolveAttachments[i].id == nullHandle)
+          continue;
+
+        GLenum drawBuffers[MAX_COLOR_ATTACHMENTS] = { GL_NONE, GL_NONE, GL_NONE, GL_NONE };
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glDrawBuffers(i + 1, drawBuffers);
+        glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      }
+      glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer._id);
+    }
+
+    // lets tiled GPUs skip writing attachments back to memory
+    GLenum discarded[MAX_COLOR_ATTACHMENTS + 1];
+    GLsizei discardedCount = 0;
+    for (uint32_t i = 0; i < _colorAttachmentCount; i++) {
+      if (_desc.colorAttachments[i].storeOp == StoreOp::DONT_CARE)
+        discarded[discardedCount++] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    if (_desc.depthAttachment.image.id != nullHandle && _desc.depthAttachment.storeOp == StoreOp::DONT_CARE)
+      discarded[discardedCount++] = GL_DEPTH_STENCIL_ATTACHMENT;
+
+    if (discardedCount > 0)
+      glInvalidateFramebuffer(GL_FRAMEBUFFER, discardedCount, discarded);
+  }
+
+  void PassGL::destroy() {
+    _resolveFramebuffer.destroy();
+    _framebuffer.destroy();
+  }
+
+  bool ShaderGL::create(ShaderType type, uint32_t size, const void* data, const ShaderCache& cache) {
+    _type = type;
+
+    Hasher hasher;
+    hasher.add(GLSL_CACHE_VERSION);
+    hasher.add(data, size);
+    _hash = hasher.get();
+
+    // the translated source is cached by SPIR-V content
+    std::vector<uint8_t> cached;
+    if (cache.load(_hash, "glsl", cached)) {
+      _source.assign(cached.begin(), cached.end());
+    }
+    else {
+      _source = read(data, size);
+      cache.store(_hash, "glsl", _source.data(), _source.size());
+    }
+
+    // driver compilation is deferred until a program needs it, it is skipped when a program binary is cached
+    return !_source.empty();
+  }
+
+  bool ShaderGL::compile() {
+    // a failure is only known once the status was queried
+    if (_compileStatus != CompileStatus::NOT_STARTED)
+      return _compileStatus != CompileStatus::FAILED;
+
+    const char* src = _source.c_str();
+
+    _id = glCreateShader(toGLShaderType(_type));
     glShaderSource(_id, 1, &src, NULL);
     glCompileShader(_id);
+    _source.clear();
+    _source.shrink_to_fit();
+    _compileStatus = CompileStatus::PENDING;
 
-    int success;
-    char infoLog[512];
-    glGetShaderiv(_id, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(_id, 512, NULL, infoLog);
-      //std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-      return false;
+    // the compile status is not queried here, it would wait for the compilation to end
+    // errors are reported by the link of the program
+    return true;
+  }
+
+  bool ShaderGL::isCompiled() {
+    if (_compileStatus == CompileStatus::PENDING) {
+      int success;
+      glGetShaderiv(_id, GL_COMPILE_STATUS, &success);
+      _compileStatus = success ? CompileStatus::SUCCEEDED : CompileStatus::FAILED;
     }
 
-    return true;
+    return _compileStatus == CompileStatus::SUCCEEDED;
   }
 
   void ShaderGL::destroy() {
-    glDeleteShader(_id);
+    if (_id != 0)
+      glDeleteShader(_id);
+  }
+
+  bool ProgramGL::create(ShaderGL* const* shaders, uint32_t shaderCount, const ShaderCache* binaryCache, uint64_t key) {
+    return link(shaders, shaderCount, binaryCache, key) && finishLink(binaryCache, key);
   }
 
-  bool ProgramGL::create(const ShaderGL& vs, const ShaderGL& fs) {
+  bool ProgramGL::link(ShaderGL* const* shaders, uint32_t shaderCount, const ShaderCache* binaryCache, uint64_t key) {
+    if (shaderCount > MAX_PROGRAM_STAGES)
+      return false;
+
+    _shaderCount = shaderCount;
+    for (uint32_t i = 0; i < shaderCount; i++) {
+      _shaders[i] = shaders[i];
+    }
+
+    _fromBinary = binaryCache && loadBinary(*binaryCache, key);
+    if (_fromBinary)
+      return true;
+
+    for (uint32_t i = 0; i < shaderCount; i++) {
+      if (!shaders[i]->compile())
+        return false;
+    }
+
     _id = glCreateProgram();
-    glAttachShader(_id, vs._id);
-    glAttachShader(_id, fs._id);
+    if (binaryCache)
+      glProgramParameteri(_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (uint32_t i = 0; i < shaderCount; i++) {
+      glAttachShader(_id, shaders[i]->_id);
+    }
     glLinkProgram(_id);
 
+    return true;
+  }
+
+  bool ProgramGL::isLinkCompleted(bool parallelShaderCompile) const {
+    if (_fromBinary || !parallelShaderCompile)
+      return true;
+
+    int completed;
+    glGetProgramiv(_id, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed != 0;
+  }
+
+  bool ProgramGL::finishLink(const ShaderCache* binaryCache, uint64_t key) {
+    if (_fromBinary)
+      return true;
+
     int success;
     char infoLog[512];
     glGetProgramiv(_id, GL_LINK_STATUS, &success);
     if (!success) {
+      // a stage which failed to compile explains the link failure better than the link log
+      for (uint32_t i = 0; i < _shaderCount; i++) {
+        if (!_shaders[i]->isCompiled()) {
+          glGetShaderInfoLog(_shaders[i]->_id, 512, NULL, infoLog);
+          std::cerr << "shader compilation failed: " << infoLog << std::endl;
+          return false;
+        }
+      }
       glGetProgramInfoLog(_id, 512, NULL, infoLog);
+      std::cerr << "program link failed: " << infoLog << std::endl;
       return false;
     }
 
+    if (binaryCache)
+      storeBinary(*binaryCache, key);
+
     return true;
   }
 
+  bool ProgramGL::loadBinary(const ShaderCache& binaryCache, uint64_t key) {
+    // entry layout: binary format followed by the program binary
+    std::vector<uint8_t> data;
+    if (!binaryCache.load(key, "bin", data) || data.size() <= sizeof(GLenum))
+      return false;
+
+    GLenum format;
+    memcpy(&format, data.data(), sizeof(format));
+
+    _id = glCreateProgram();
+    glProgramBinary(_id, format, data.data() + sizeof(format), static_cast<GLsizei>(data.size() - sizeof(format)));
+
+    int success;
+    glGetProgramiv(_id, GL_LINK_STATUS, &success);
+    if (!success) {
+      // rejected by the driver (e.g. after an update), the program is linked from sources
+      glDeleteProgram(_id);
+      _id = 0;
+      return false;
+    }
+
+    return true;
+  }
+
+  void ProgramGL::storeBinary(const ShaderCache& binaryCache, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+      return;
+
+    std::vector<uint8_t> data(sizeof(GLenum) + length);
+    GLenum format;
+    glGetProgramBinary(_id, length, nullptr, &format, data.data() + sizeof(format));
+    memcpy(data.data(), &format, sizeof(format));
+
+    binaryCache.store(key, "bin", data.data(), data.size());
+  }
+
   void ProgramGL::destroy() {
     glDeleteProgram(_id);
   }
@@ -179,33 +1186,141 @@ namespace jgfx::gl {
     glUseProgram(_id);
   }
 
-  void ProgramGL::bindAttributes(const VertexAttributes& attr) {
-    for (int i = 0; i < attr._attrCount; ++i)
+  bool VertexArrayGL::create(const VertexAttributes& attr) {
+    glGenVertexArrays(1, &_id);
+    glBindVertexArray(_id);
+
+    // the format is separated from the buffers, bound later by applyBindings
+    for (int i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i)
     {
-      GLint count = getAttribTypeComponentsCount(attr._types[i]);
-      glVertexAttribPointer(i, count, GL_FLOAT, GL_FALSE, attr._stride, (void*)0);
+      if (attr._types[i] == UNKNOWN)
+        continue;
+
+      AttribFormatGL format = toGLAttribFormat(attr._types[i]);
+      if (format.integer)
+        glVertexAttribIFormat(i, format.count, format.type, attr._offsets[i]);
+      else
+        glVertexAttribFormat(i, format.count, format.type, format.normalized, attr._offsets[i]);
+      glVertexAttribBinding(i, attr._bindings[i]);
       glEnableVertexAttribArray(i);
     }
+
+    for (int i = 0; i < MAX_BUFFER_BIND; ++i)
+    {
+      if (attr._stepRates[i] == VertexStepRate::PER_INSTANCE)
+        glVertexBindingDivisor(i, 1);
+    }
+
+    return _id != 0;
   }
 
+  void VertexArrayGL::destroy() {
+    if (_id != 0)
+      glDeleteVertexArrays(1, &_id);
+    _id = 0;
+  }
+
+  bool BufferGL::create(uint32_t size, const void* data, BufferUsage usage, uint32_t framesInFlight, bool persistentMapping) {
+    _sliceCount = getBufferSliceCount(usage, framesInFlight);
+    _sliceSize = _sliceCount > 1 ? (size + BUFFER_SLICE_ALIGNMENT - 1) / BUFFER_SLICE_ALIGNMENT * BUFFER_SLICE_ALIGNMENT : size;
+    _activeSlice = 0;
+    _mapped = nullptr;
 
-  bool BufferGL::create(uint32_t size, const void* data) {
     glGenBuffers(1, &_id);
     glBindBuffer(GL_ARRAY_BUFFER, _id);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+
+    if (usage == BufferUsage::STATIC) {
+      glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    }
+    else if (persistentMapping) {
+      // coherent mapping: writes are visible to the next commands without explicit flushes
+      const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_ARRAY_BUFFER, _sliceSize * _sliceCount, nullptr, flags);
+      _mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, _sliceSize * _sliceCount, flags));
+      if (!_mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return false; // todo error handling
+      }
+      if (data)
+        memcpy(_mapped, data, size);
+    }
+    else {
+      glBufferData(GL_ARRAY_BUFFER, _sliceSize * _sliceCount, nullptr, usage == BufferUsage::STREAM ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
+      if (data)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    _sliceFrames.assign(_mapped ? _sliceCount : 0, 0);
 
     return true;
   }
 
+  bool BufferGL::grow(unsigned int& previousId) {
+    uint32_t sliceCount = _sliceCount * 2;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    unsigned int id;
+    glGenBuffers(1, &id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, _sliceSize * sliceCount, nullptr, flags);
+    uint8_t* mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, _sliceSize * sliceCount, flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!mapped) {
+      glDeleteBuffers(1, &id);
+      return false;
+    }
+
+    // the slices of the new buffer are all free, the next update writes the first one
+    previousId = _id;
+    _id = id;
+    _mapped = mapped;
+    _sliceCount = sliceCount;
+    _activeSlice = sliceCount - 1;
+    _sliceFrames.assign(sliceCount, 0);
+    return true;
+  }
+
+  void BufferGL::update(const void* data, uint32_t size) {
+    if (_sliceCount == 1 || size > _sliceSize)
+      return; // todo error handling
+
+    _activeSlice = (_activeSlice + 1) % _sliceCount;
+    if (_mapped) {
+      memcpy(_mapped + getOffset(), data, size);
+      return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, getOffset(), size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+
+  uint32_t BufferGL::getOffset() const {
+    return _activeSlice * _sliceSize;
+  }
+
 
   void BufferGL::destroy() {
+    if (_mapped) {
+      glBindBuffer(GL_ARRAY_BUFFER, _id);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      _mapped = nullptr;
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glDeleteBuffers(1, &_id);
   }
 
   bool PipelineGL::create(const PipelineDesc& desc) {
     _desc = desc;
+    _compute = false;
+    return true;
+  }
+
+  bool PipelineGL::createCompute(const ComputePipelineDesc& desc) {
+    _desc = PipelineDesc();
+    _desc.program = desc.program;
+    _compute = true;
     return true;
   }
 }
\ No newline at end of file
@@ -1,47 +1,135 @@
 #pragma once
 
 #include "renderer.h"
+#include "shader_cache.h"
+#include "hash.h"
+
+#include <string>
+
+typedef struct __GLsync* GLsync; // same declaration as glad, avoids including it here
 
 namespace jgfx::gl {
+  constexpr uint32_t MAX_PROGRAM_STAGES = 2; // vertex and fragment, or compute
+  constexpr uint32_t UNIFORM_BUFFER_SIZE = 64 << 10; // max size of applyUniforms data
+  constexpr uint32_t UNIFORM_RING_FRAME_SIZE = 1 << 20; // initial size of the applyUniforms data of a frame
+  constexpr uint32_t UNIFORM_BINDING = 0; // binding point receiving applyUniforms data
+
   struct TextureGL {
-    bool create();
+    // the data goes through unpackBuffer when not 0, so that the copy to the texture doesn't block
+    bool create(const TextureDesc& desc, const void* data, uint32_t size, bool directStateAccess, unsigned int unpackBuffer);
     void destroy();
+
+    unsigned int _id = 0;
+    unsigned int _internalFormat = 0;
+    unsigned int _target = 0; // 2D or 2D multisample
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+    uint32_t _levels = 1;
+  };
+
+  struct SamplerGL {
+    bool create(const SamplerDesc& desc, float maxAnisotropy);
+    void destroy();
+
+    unsigned int _id = 0;
   };
 
   struct FramebufferGL {
     bool create();
     void destroy();
 
-    unsigned int _id;
+    unsigned int _id = 0;
+  };
+
+  /// <summary>
+  /// Offscreen pass, emulates load and store ops with clears, invalidations and blits
+  /// </summary>
+  struct PassGL {
+    bool create(const PassDesc& desc, const TextureGL* textures);
+    void begin();
+    void end();
+    void destroy();
+
+    FramebufferGL _framebuffer;
+    FramebufferGL _resolveFramebuffer; // 0 without resolve attachments
+    PassDesc _desc;
+    uint32_t _colorAttachmentCount = 0;
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+  };
+
+  enum class CompileStatus {
+    NOT_STARTED,
+    PENDING, // submitted to the driver, not queried yet
+    SUCCEEDED,
+    FAILED
   };
 
   struct ShaderGL {
-    bool create(ShaderType type, uint32_t size, const void* data);
+    bool create(ShaderType type, uint32_t size, const void* data, const ShaderCache& cache);
+    bool compile();
+    bool isCompiled();
     void destroy();
 
-    unsigned int _id;
+    unsigned int _id = 0; // 0 until compiled
+    CompileStatus _compileStatus = CompileStatus::NOT_STARTED;
+    ShaderType _type = ShaderType::VERTEX;
+    uint64_t _hash = 0; // hash of the SPIR-V code
+    std::string _source; // GLSL source, released once compiled
   };
 
   struct ProgramGL {
-    bool create(const ShaderGL& vs, const ShaderGL& fs);
+    bool create(ShaderGL* const* shaders, uint32_t shaderCount, const ShaderCache* binaryCache, uint64_t key);
+    // creation split in two steps, so that the driver can work on several programs at once
+    bool link(ShaderGL* const* shaders, uint32_t shaderCount, const ShaderCache* binaryCache, uint64_t key);
+    bool isLinkCompleted(bool parallelShaderCompile) const;
+    bool finishLink(const ShaderCache* binaryCache, uint64_t key);
+    bool loadBinary(const ShaderCache& binaryCache, uint64_t key);
+    void storeBinary(const ShaderCache& binaryCache, uint64_t key);
     void destroy();
     void use();
-    void bindAttributes(const VertexAttributes& attr);
 
     unsigned int _id;
+    ShaderGL* _shaders[MAX_PROGRAM_STAGES] = {};
+    uint32_t _shaderCount = 0;
+    bool _fromBinary = false;
+  };
+
+  /// <summary>
+  /// Vertex array of a vertex layout, attribute formats are only specified at creation.
+  /// Remembers the buffers bound to it so that unchanged geometry is not bound again
+  /// </summary>
+  struct VertexArrayGL {
+    bool create(const VertexAttributes& attr);
+    void destroy();
+
+    unsigned int _id = 0;
+    unsigned int _vertexBuffers[MAX_BUFFER_BIND] = {};
+    intptr_t _vertexBufferOffsets[MAX_BUFFER_BIND] = {};
+    unsigned int _indexBuffer = 0;
   };
 
   struct BufferGL {
-    bool create(uint32_t size, const void* data);
+    bool create(uint32_t size, const void* data, BufferUsage usage, uint32_t framesInFlight, bool persistentMapping);
+    void update(const void* data, uint32_t size);
+    bool grow(unsigned int& previousId);
     void destroy();
+    uint32_t getOffset() const;
 
     unsigned int _id;
+    uint32_t _sliceSize = 0;
+    uint32_t _sliceCount = 1;
+    uint32_t _activeSlice = 0; // slice read by the commands recorded after the last update
+    uint8_t* _mapped = nullptr; // persistently mapped storage, null for static buffers
+    std::vector<uint64_t> _sliceFrames; // frame that last read each slice of mapped buffers, 0 when never read
   };
 
   struct PipelineGL {
     bool create(const PipelineDesc& desc);
+    bool createCompute(const ComputePipelineDesc& desc);
 
-    PipelineDesc _desc;
+    PipelineDesc _desc; // only the program is used by compute pipelines
+    bool _compute = false;
   };
 
   struct RenderContextGL : public RenderContext {
@@ -49,34 +137,91 @@ namespace jgfx::gl {
     bool init(const InitInfo& createInfo) override;
     void shutdown() override;
     void updateResolution(const Resolution& resolution) override;
+    bool isBindless() const override;
+    bool supportsDrawIndirectCount() const override;
 
     // ObjectGL creation
     void newPipeline(PipelineHandle handle, const PipelineDesc& pipelineDesc) override;
     void newPass(PassHandle handle, const PassDesc& passDesc) override;
     void newShader(ShaderHandle handle, ShaderType type, const void* binData, uint32_t size) override;
     void newProgram(ProgramHandle handle, ShaderHandle vsHandle, ShaderHandle fsHandle) override;
-    void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type) override;
+    void newComputeProgram(ProgramHandle handle, ShaderHandle cs) override;
+    void newComputePipeline(PipelineHandle handle, const ComputePipelineDesc& pipelineDesc) override;
+    void newShaders(const ShaderHandle* handles, const ShaderDesc* descs, uint32_t count) override;
+    void newPrograms(const ProgramHandle* handles, const ProgramDesc* descs, uint32_t count) override;
+    void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type, BufferUsage usage) override;
+    void updateBuffer(BufferHandle handle, const void* data, uint32_t size) override;
     void newUniformBuffer(UniformBufferHandle handle, uint32_t size) override;
     void newImage(ImageHandle handle, const void* data, uint32_t size, const TextureDesc& desc) override;
+    void newAliasedImages(const ImageHandle* handles, const TextureDesc* descs, uint32_t count) override;
+    void newSampler(SamplerHandle handle, const SamplerDesc& desc) override;
 
     // cmds
     void beginDefaultPass() override;
     void beginPass(PassHandle pass) override;
     void applyPipeline(PipelineHandle pipe) override;
+    void applyDepthStencilState(const PipelineDesc& desc);
     void applyBindings(const Bindings& bindings) override;
+    // vertex and index buffers, bound to the current vertex array
+    void applyVertexBindings(const Bindings& bindings);
     void applyUniforms(ShaderStage stage, const void* data, uint32_t size) override;
-    void draw(uint32_t firstVertex, uint32_t vertexCount) override;
-    void drawIndexed(uint32_t firstIndex, uint32_t indexCount) override;
+    void setCullMode(CullMode mode) override;
+    void setFaceWinding(FaceWinding faceWinding) override;
+    void setPrimitiveType(PrimitiveType primitive) override;
+    void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) override;
+    void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) override;
+    void drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) override;
+    void drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) override;
     void endPass() override;
+    void barrier(const ResourceBarrier* barriers, uint32_t count) override;
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+    void dispatchIndirect(BufferHandle buffer, uint32_t offset) override;
+    void fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) override;
     void commitFrame() override;
 
-    unsigned int _vao; // default vao
+    const ShaderCache* getBinaryCache() const;
+    uint64_t getProgramKey(const ShaderHandle* shaders, uint32_t shaderCount) const;
+    // replaces the uniform buffer with one of frameSize bytes per frame in flight
+    void createUniformRing(uint32_t frameSize);
+
+    HashCache<VertexAttributes, VertexArrayGL> _vertexArrays; // keyed by their vertex layout
+    VertexArrayGL* _currentVertexArray = nullptr; // vertex array of the current pipeline
+    Bindings _currentBindings; // re-applied to the vertex array of each new pipeline
+    bool _multiBind = false; // GL_ARB_multi_bind, vertex buffers are bound with a single call
+    Resolution _resolution; // size of the default framebuffer
+    unsigned int _uniformBuffer = 0; // applyUniforms data, one region per frame in flight written in sequence
+    uint8_t* _uniformMapped = nullptr; // persistently mapped with GL_ARB_buffer_storage
+    uint32_t _uniformOffset = 0; // in the region of the current frame
+    uint32_t _uniformFrameSize = 0; // size of the region of each frame, doubled when a frame needs more
+    uint32_t _uniformAlignment = 256;
+    ShaderCache _shaderCache;
+    uint64_t _driverHash = 0; // program binaries are only valid for the driver that produced them
+    bool _programBinarySupported = false;
+    bool _parallelShaderCompile = false; // GL_KHR_parallel_shader_compile
+    bool _bufferStorage = false; // GL_ARB_buffer_storage, dynamic buffers are persistently mapped
+    float _maxAnisotropy = 1.0f; // 1 without GL_EXT_texture_filter_anisotropic
+    bool _directStateAccess = false; // GL_ARB_direct_state_access, textures are created and bound without touching the binding points
+    unsigned int _unpackBuffer = 0; // pixel unpack buffer of texture uploads, orphaned on each upload
+    GLsync _frameFences[MAX_FRAMES_IN_FLIGHT] = {}; // signaled when the GPU is done with a frame
+    uint32_t _frameIndex = 0;
+    uint32_t _framesInFlight = MAX_FRAMES_IN_FLIGHT;
+    uint64_t _frameNumber = 1; // frames up to _frameNumber - _framesInFlight are done
+    std::vector<std::pair<unsigned int, uint64_t>> _retiredBuffers; // buffers replaced by a bigger one, and the frame that last read them
+    bool _lowLatency = false;
+    PrimitiveType _primitive = TRIANGLES; // primitive of the current pipeline
+    uint32_t _vertexStrides[MAX_BUFFER_BIND] = {}; // strides of the current pipeline
+    IndexType _indexType = IndexType::UINT16; // index buffer of the current bindings
+    uint32_t _indexBufferOffset = 0;
 
     ShaderGL _shaders[MAX_SHADERS];
     ProgramGL _programs[MAX_PROGRAMS];
     BufferGL _buffers[MAX_BUFFERS];
     TextureGL _textures[MAX_IMAGES];
+    SamplerGL _samplers[MAX_SAMPLERS];
+    SamplerGL _defaultSampler; // used by image slots without sampler
     FramebufferGL _framebuffer[MAX_FRAMEBUFFERS];
+    PassGL _passes[MAX_PASSES];
+    PassHandle _currentPass; // null in the default pass
     PipelineGL _pipelines[MAX_PIPELINES];
   };
 }
\ No newline at end of file
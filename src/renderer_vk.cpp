@@ -4,11 +4,38 @@
 
 #include "jgfx/jgfx.h"
 #include "utils_vk.h"
+#include "hash.h"
+#include "parallel.h"
 
+#include <algorithm>
 #include <set>
 #include <iostream>
 
 namespace jgfx::vk {
+  static_assert(sizeof(DrawIndirectCommand) == sizeof(VkDrawIndirectCommand), "indirect arguments layout mismatch");
+  static_assert(sizeof(DrawIndexedIndirectCommand) == sizeof(VkDrawIndexedIndirectCommand), "indirect arguments layout mismatch");
+
+  // same feature names in VkPhysicalDeviceVulkan12Features and VkPhysicalDeviceDescriptorIndexingFeatures
+  template<typename Features>
+  static bool supportsBindlessHeap(const Features& features) {
+    return features.runtimeDescriptorArray &&
+      features.descriptorBindingPartiallyBound &&
+      features.descriptorBindingUpdateUnusedWhilePending &&
+      features.descriptorBindingSampledImageUpdateAfterBind &&
+      features.descriptorBindingStorageImageUpdateAfterBind &&
+      features.descriptorBindingStorageBufferUpdateAfterBind;
+  }
+
+  template<typename Features>
+  static void enableBindlessHeap(Features& features) {
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  }
+
   static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
     std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
 
@@ -36,7 +63,7 @@ namespace jgfx::vk {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_3; // optional features are queried against the device api version
 
     // Instance def
     VkInstanceCreateInfo vkCreateInfo{};
@@ -75,23 +102,36 @@ namespace jgfx::vk {
       return false;
 
     // We need the swap chain extension for drawing to screen
-    const std::vector<const char*> deviceExtensions = {
+    std::vector<const char*> deviceExtensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
     if (!pickPhysicalDevice(_swapChain._surface, deviceExtensions))
       return false;
 
+    // adds supported optional extensions
+    selectOptionalFeatures(initInfo, deviceExtensions);
+
     if (!createLogicalDevice(_swapChain._surface, deviceExtensions))
       return false;
 
+    loadDeviceFunctions();
+    _pipelineCache._dynamicRasterState = _features.extendedDynamicState;
+
+    _framesInFlight = getFramesInFlight(initInfo);
+    _lowLatency = initInfo.lowLatency;
+    _swapChain._presentMode = utils::toVkPresentMode(initInfo.presentMode);
+
     if (!_swapChain.createSwapChain(_device, _physicalDevice, initInfo.resolution))
       return false;
 
     if (!_swapChain.createImageViews(_device))
       return false;
 
-    if (!_defaultPass.create(_device, _swapChain._imageFormat))
+    if (!_swapChain.createDepthImage(_device, _physicalDevice))
+      return false;
+
+    if (!_defaultPass.create(_device, _swapChain._imageFormat, _swapChain._depthFormat))
       return false;
 
     if (!_swapChain.createFramebuffers(_device, _defaultPass._renderPass))
@@ -100,17 +140,32 @@ namespace jgfx::vk {
     if (!_cmdQueue.createCommandPool(_device, _physicalDevice, _swapChain._surface))
       return false;
 
+    _cmdQueue._framesInFlight = _framesInFlight;
     if (!_cmdQueue.createCommandBuffers(_device))
       return false;
 
     if (!_cmdQueue.createSyncObjects(_device))
       return false;
 
-    if (!createDescriptorPool())
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+    if (_physicalDeviceFeatures.samplerAnisotropy)
+      _maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    _uniformAlignment = static_cast<uint32_t>(properties.limits.minUniformBufferOffsetAlignment);
+    _uniformDefaultRange = std::min(UNIFORM_BUFFER_SIZE, properties.limits.maxUniformBufferRange);
+    // the uniform descriptor is always written, so the rings exist before the first applyUniforms
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+      if (!growUniformRing(i, UNIFORM_RING_FRAME_SIZE))
+        return false;
+    }
+    if (!_defaultSampler.create(_device, SamplerDesc(), _maxAnisotropy))
       return false;
 
-    // TODO: to move
-    _uniformBuffers[0].create(_device, _physicalDevice, 1 << 20);
+    if (_features.descriptorIndexing) {
+      if (!_bindlessHeap.create(_device))
+        return false;
+      _layoutCache._bindlessSetLayout = _bindlessHeap._setLayout;
+    }
 
     _swapChain.acquire(_device);
 
@@ -125,13 +180,15 @@ namespace jgfx::vk {
 
     _cmdQueue.destroy(_device);
 
-    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    for (DescriptorAllocatorVK& descriptorAllocator : _descriptorAllocators)
+      descriptorAllocator.destroy(_device);
     //for (int i = 0; i < MAX_FRAMEBUFFERS; i++) {
     //  _framebuffers[i].destroy(_device);
     //}
     for (int i = 0; i < MAX_PIPELINES; i++) {
       _pipelines[i].destroy(_device);
     }
+    _pipelineCache.destroy(_device);
     for (int i = 0; i < MAX_PASSES; i++) {
       _passes[i].destroy(_device);
     }
@@ -139,6 +196,12 @@ namespace jgfx::vk {
     for (int i = 0; i < MAX_SHADERS; i++) {
       _shaders[i].destroy(_device);
     }
+    _bindlessHeap.destroy(_device);
+    _layoutCache.destroy(_device);
+    for (SamplerVK& sampler : _samplers) {
+      sampler.destroy(_device);
+    }
+    _defaultSampler.destroy(_device);
     _swapChain.destroy(_device);
     _swapChain.destroySurface(_instance);
 
@@ -149,6 +212,9 @@ namespace jgfx::vk {
     for (int i = 0; i < MAX_BUFFERS; i++) {
       _buffers[i].destroy(_device);
     }
+    for (BufferVK& uniformRing : _uniformRings) {
+      uniformRing.destroy(_device);
+    }
     for (int i = 0; i < MAX_BUFFERS; i++) {
       _uniformBuffers[i].destroy(_device);
   }
@@ -187,6 +253,8 @@ namespace jgfx::vk {
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
         _physicalDeviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+        _physicalDeviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        _physicalDeviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
         return true;
       }
@@ -195,6 +263,149 @@ namespace jgfx::vk {
     return false;
   }
 
+  void RenderContextVK::selectOptionalFeatures(const InitInfo& initInfo, std::vector<const char*>& deviceExtensions) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+    _features.apiVersion = properties.apiVersion;
+
+    if (initInfo.extendedDynamicState) {
+      if (_features.apiVersion >= VK_API_VERSION_1_3) {
+        // core in 1.3
+        _features.extendedDynamicState = true;
+      }
+      else if (utils::checkDeviceExtensionSupport(_physicalDevice, { VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME })) {
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+        dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &dynamicStateFeatures;
+        vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+        if (dynamicStateFeatures.extendedDynamicState) {
+          deviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+          _features.extendedDynamicState = true;
+        }
+      }
+    }
+
+    _features.multiDrawIndirect = _physicalDeviceFeatures.multiDrawIndirect;
+
+    if (_features.apiVersion >= VK_API_VERSION_1_2) {
+      // core in 1.2 behind a feature bit
+      VkPhysicalDeviceVulkan12Features vulkan12Features{};
+      vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &vulkan12Features;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      _features.drawIndirectCount = vulkan12Features.drawIndirectCount;
+      _features.timelineSemaphore = vulkan12Features.timelineSemaphore;
+      _features.descriptorIndexing = initInfo.bindless && supportsBindlessHeap(vulkan12Features);
+    }
+    else if (utils::checkDeviceExtensionSupport(_physicalDevice, { VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME })) {
+      deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+      _features.drawIndirectCount = true;
+    }
+
+    if (initInfo.lowLatency && utils::checkDeviceExtensionSupport(_physicalDevice, { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME })) {
+      VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+      presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+      VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+      presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+      presentIdFeatures.pNext = &presentWaitFeatures;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &presentIdFeatures;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      if (presentIdFeatures.presentId && presentWaitFeatures.presentWait) {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        _features.presentWait = true;
+      }
+    }
+
+    if (initInfo.bindless && _features.apiVersion < VK_API_VERSION_1_2 && _features.apiVersion >= VK_API_VERSION_1_1 &&
+      utils::checkDeviceExtensionSupport(_physicalDevice, { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME })) {
+      VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+      descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &descriptorIndexingFeatures;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      if (supportsBindlessHeap(descriptorIndexingFeatures)) {
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        _features.descriptorIndexing = true;
+      }
+    }
+
+    if (_features.descriptorIndexing) {
+      // the heap holds a descriptor for every image and buffer handle
+      VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+      indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+      VkPhysicalDeviceProperties2 properties2{};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties2.pNext = &indexingProperties;
+      vkGetPhysicalDeviceProperties2(_physicalDevice, &properties2);
+
+      _features.descriptorIndexing =
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers >= MAX_IMAGES &&
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= MAX_IMAGES &&
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageImages >= MAX_IMAGES &&
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers >= MAX_BUFFERS &&
+        indexingProperties.maxPerStageUpdateAfterBindResources >= MAX_IMAGES * 2 + MAX_BUFFERS;
+    }
+
+    if (_features.apiVersion < VK_API_VERSION_1_2 && utils::checkDeviceExtensionSupport(_physicalDevice, { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME })) {
+      VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+      timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &timelineSemaphoreFeatures;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      if (timelineSemaphoreFeatures.timelineSemaphore) {
+        deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        _features.timelineSemaphore = true;
+      }
+    }
+
+    if (_features.apiVersion >= VK_API_VERSION_1_3) {
+      // core in 1.3 behind a feature bit
+      VkPhysicalDeviceVulkan13Features vulkan13Features{};
+      vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &vulkan13Features;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      _features.synchronization2 = vulkan13Features.synchronization2;
+    }
+    else if (utils::checkDeviceExtensionSupport(_physicalDevice, { VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME })) {
+      VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+      synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+      VkPhysicalDeviceFeatures2 features{};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &synchronization2Features;
+      vkGetPhysicalDeviceFeatures2(_physicalDevice, &features);
+
+      if (synchronization2Features.synchronization2) {
+        deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        _features.synchronization2 = true;
+      }
+    }
+  }
+
   bool RenderContextVK::createLogicalDevice(VkSurfaceKHR surface, const std::vector<const char*>& deviceExtensions) {
     // Check for available queue families
     QueueFamilyIndices indices = utils::findQueueFamilies(_physicalDevice, surface);
@@ -215,9 +426,81 @@ namespace jgfx::vk {
       queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // Optional features
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.drawIndirectCount = _features.drawIndirectCount;
+    vulkan12Features.timelineSemaphore = _features.timelineSemaphore;
+    if (_features.descriptorIndexing)
+      enableBindlessHeap(vulkan12Features);
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    enableBindlessHeap(descriptorIndexingFeatures);
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+
+    VkPhysicalDeviceVulkan13Features vulkan13Features{};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.synchronization2 = VK_TRUE;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    synchronization2Features.synchronization2 = VK_TRUE;
+
+    void* features = nullptr;
+    if (_features.extendedDynamicState && _features.apiVersion < VK_API_VERSION_1_3) {
+      dynamicStateFeatures.pNext = features;
+      features = &dynamicStateFeatures;
+    }
+    if (_features.apiVersion >= VK_API_VERSION_1_2) {
+      vulkan12Features.pNext = features;
+      features = &vulkan12Features;
+    }
+    else {
+      if (_features.timelineSemaphore) {
+        timelineSemaphoreFeatures.pNext = features;
+        features = &timelineSemaphoreFeatures;
+      }
+      if (_features.descriptorIndexing) {
+        descriptorIndexingFeatures.pNext = features;
+        features = &descriptorIndexingFeatures;
+      }
+    }
+    if (_features.presentWait) {
+      presentIdFeatures.pNext = features;
+      presentWaitFeatures.pNext = &presentIdFeatures;
+      features = &presentWaitFeatures;
+    }
+    if (_features.synchronization2) {
+      if (_features.apiVersion >= VK_API_VERSION_1_3) {
+        vulkan13Features.pNext = features;
+        features = &vulkan13Features;
+      }
+      else {
+        synchronization2Features.pNext = features;
+        features = &synchronization2Features;
+      }
+    }
+
     // Logical device def
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = features;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &_physicalDeviceFeatures;
@@ -238,23 +521,35 @@ namespace jgfx::vk {
     return true;
   }
 
-  bool RenderContextVK::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  void RenderContextVK::loadDeviceFunctions() {
+    if (_features.extendedDynamicState) {
+      // core entry points have no suffix
+      bool core = _features.apiVersion >= VK_API_VERSION_1_3;
+      _cmdQueue._cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(_device, core ? "vkCmdSetCullMode" : "vkCmdSetCullModeEXT");
+      _cmdQueue._cmdSetFrontFace = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(_device, core ? "vkCmdSetFrontFace" : "vkCmdSetFrontFaceEXT");
+      _cmdQueue._cmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(_device, core ? "vkCmdSetPrimitiveTopology" : "vkCmdSetPrimitiveTopologyEXT");
+    }
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    if (_features.drawIndirectCount) {
+      bool core = _features.apiVersion >= VK_API_VERSION_1_2;
+      _cmdQueue._cmdDrawIndirectCount = (PFN_vkCmdDrawIndirectCountKHR)vkGetDeviceProcAddr(_device, core ? "vkCmdDrawIndirectCount" : "vkCmdDrawIndirectCountKHR");
+      _cmdQueue._cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, core ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirectCountKHR");
+    }
 
-    if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
-      return false;
+    if (_features.synchronization2) {
+      bool core = _features.apiVersion >= VK_API_VERSION_1_3;
+      _cmdQueue._cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(_device, core ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR");
     }
 
-    return true;
+    if (_features.timelineSemaphore) {
+      bool core = _features.apiVersion >= VK_API_VERSION_1_2;
+      _cmdQueue._getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(_device, core ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+      _cmdQueue._waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(_device, core ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+    }
+
+    if (_features.presentWait) {
+      _swapChain._waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(_device, "vkWaitForPresentKHR");
+    }
   }
 
   VkResult RenderContextVK::createDebugUtilsMessengerEXT(const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator) {
@@ -272,9 +567,18 @@ namespace jgfx::vk {
     _swapChain._resolution = resolution;
   }
 
+  bool RenderContextVK::isBindless() const {
+    return _bindlessHeap._set != VK_NULL_HANDLE;
+  }
+
+  bool RenderContextVK::supportsDrawIndirectCount() const {
+    return _features.drawIndirectCount;
+  }
+
   void RenderContextVK::newShader(ShaderHandle handle, ShaderType type, const void* binData, uint32_t size) {
     _shaders[handle.id].create(
       _device, 
+      type,
       binData,
       size
     );
@@ -282,69 +586,160 @@ namespace jgfx::vk {
 
   void RenderContextVK::newProgram(ProgramHandle handle, ShaderHandle vs, ShaderHandle fs) {
     _programs[handle.id].create(
+      _device,
+      _layoutCache,
       vs,
-      fs
+      fs,
+      _shaders[vs.id],
+      _shaders[fs.id]
+    );
+  }
+
+  void RenderContextVK::newComputeProgram(ProgramHandle handle, ShaderHandle cs) {
+    _programs[handle.id].createCompute(
+      _device,
+      _layoutCache,
+      cs,
+      _shaders[cs.id]
+    );
+  }
+
+  void RenderContextVK::newComputePipeline(PipelineHandle handle, const ComputePipelineDesc& pipelineDesc) {
+    const ProgramVK& program = _programs[pipelineDesc.program.id];
+    _pipelines[handle.id].createCompute(
+      _device,
+      _shaders[program._cs.id],
+      program._pipelineLayout,
+      pipelineDesc
     );
   }
 
-  void RenderContextVK::newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type) {
+  void RenderContextVK::newShaders(const ShaderHandle* handles, const ShaderDesc* descs, uint32_t count) {
+    // reflection and module creation don't need external synchronization
+    parallelFor(count, [&](uint32_t i) {
+      _shaders[handles[i].id].create(
+        _device,
+        descs[i].type,
+        descs[i].binData,
+        descs[i].size
+      );
+    });
+  }
+
+  void RenderContextVK::newPrograms(const ProgramHandle* handles, const ProgramDesc* descs, uint32_t count) {
+    // layouts are shared through the layout cache, programs are created serially
+    for (uint32_t i = 0; i < count; i++) {
+      newProgram(handles[i], descs[i].vs, descs[i].fs);
+    }
+  }
+
+  void RenderContextVK::newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type, BufferUsage usage) {
     void* mappedMem;
 
-    VkBufferUsageFlags usage;
+    VkBufferUsageFlags usageFlags;
     switch (type) {
-    case VERTEX_BUFFER: usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    case VERTEX_BUFFER: usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+      break;
+    case INDEX_BUFFER: usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
       break;
-    case INDEX_BUFFER: usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    case UNIFORM_BUFFER: usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
       break;
-    case UNIFORM_BUFFER: usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    case INDIRECT_BUFFER: usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+      break;
+    case STORAGE_BUFFER: usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
       break;
     }
 
+    // dynamic and stream buffers hold one aligned slice per frame in flight
+    BufferVK& buffer = _buffers[handle.id];
+    uint32_t sliceCount = getBufferSliceCount(usage, _framesInFlight);
+    uint32_t sliceSize = sliceCount > 1 ? (size + BUFFER_SLICE_ALIGNMENT - 1) / BUFFER_SLICE_ALIGNMENT * BUFFER_SLICE_ALIGNMENT : size;
+
     // create the buffer and prepare mapped memory
-    _buffers[handle.id].create(
+    if (!buffer.create(
       _device,
       _physicalDevice,
-      size,
-      usage,
+      sliceSize * sliceCount,
+      usageFlags,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host buffer
       &mappedMem
-    );
+    ))
+      return; // todo error handling
+    buffer._sliceSize = sliceSize;
+    buffer._sliceCount = sliceCount;
+    buffer._activeSlice = 0;
+    buffer._sliceValues.assign(usage == BufferUsage::STATIC ? 0 : sliceCount, 0);
 
     // copy data in mapped memory
-    memcpy(mappedMem, data, static_cast<size_t>(size));
-
-    // unmap memory
-    _buffers[handle.id].unmapMemory(_device);
+    if (data)
+      memcpy(mappedMem, data, static_cast<size_t>(size));
+
+    // static buffers are unmapped, the others stay mapped for updates
+    if (usage == BufferUsage::STATIC)
+      buffer.unmapMemory(_device);
+    else
+      buffer._mapped = static_cast<uint8_t*>(mappedMem);
+
+    // the slice of dynamic buffers changes with every update, only static ones are indexed
+    if (isBindless() && usage == BufferUsage::STATIC && (usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+      _bindlessHeap.writeBuffer(_device, handle.id, buffer._buffer, size);
+  }
+
+  void RenderContextVK::updateBuffer(BufferHandle handle, const void* data, uint32_t size) {
+    BufferVK& buffer = _buffers[handle.id];
+    if (buffer._sliceValues.empty())
+      return; // todo error handling, static buffer
+
+    // the commands recorded so far read the current slice
+    buffer._sliceValues[buffer._activeSlice] = _cmdQueue.getRecordingValue();
+
+    // Updated more than once per frame, the next slice may still be read by a submission in flight, or even by
+    // the commands being recorded. Rather than waiting mid-frame, the buffer gets more slices until it has enough
+    uint64_t nextValue = buffer._sliceValues[(buffer._activeSlice + 1) % buffer._sliceCount];
+    if (nextValue > _cmdQueue._completedValue && nextValue > _cmdQueue.getCompletedValue(_device)) {
+      if (!buffer.grow(_device, _physicalDevice, _cmdQueue))
+        return; // todo error handling, the content is left untouched
+    }
+    buffer.update(data, size);
   }
 
+
+
   void RenderContextVK::newUniformBuffer(UniformBufferHandle handle, uint32_t size) {
     _uniformBuffers[handle.id].create(
       _device,
       _physicalDevice,
-      size
+      size,
+      _framesInFlight
     );
   }
 
   void RenderContextVK::newPipeline(PipelineHandle handle, const PipelineDesc& pipelineDesc) {
     const ProgramVK& program = _programs[pipelineDesc.program.id];
+    // the pipeline stays null, its draws are skipped by applyPipeline
+    if (!program.validateVertexAttributes(pipelineDesc.vertexAttributes))
+      return; // todo error handling
+
     const ShaderVK& vs = _shaders[program._vs.id];
     const ShaderVK& fs = _shaders[program._fs.id];
+    // pipelines without pass render into the swap chain
+    const PassVK& pass = pipelineDesc.pass.id == nullHandle ? _defaultPass : _passes[pipelineDesc.pass.id];
     _pipelines[handle.id].create(
       _device, 
+      _pipelineCache,
       vs,
       fs,
-      _defaultPass,//_passes[pass.id]
+      pass,
+      program._pipelineLayout,
       pipelineDesc      
     );
-
-    _currentVertexShader = program._vs;
-    _currentFragmentShader = program._fs;
   }
 
   void RenderContextVK::newPass(PassHandle handle, const PassDesc& passDesc) {
     _passes[handle.id].create(
       _device,
-      _swapChain._imageFormat
+      passDesc,
+      _images
     );
   }
 
@@ -353,57 +748,434 @@ namespace jgfx::vk {
       _device,
       _physicalDevice,
       _cmdQueue,
-      desc.width,
-      desc.height,
+      desc,
       data
     );
+
+    if (isBindless())
+      _bindlessHeap.writeImage(_device, handle.id, _images[handle.id], _defaultSampler._sampler, desc.usage == TextureUsage::STORAGE);
+  }
+
+  void RenderContextVK::newAliasedImages(const ImageHandle* handles, const TextureDesc* descs, uint32_t count) {
+    if (count == 0)
+      return;
+
+    // the memory fits the largest image
+    VkDeviceSize memorySize = 0;
+    uint32_t memoryTypeBits = ~0u;
+    uint32_t created = 0;
+    for (; created < count; created++) {
+      ImageVK& image = _images[handles[created].id];
+      if (!image.createImage(_device, _physicalDevice, descs[created]))
+        break;
+
+      VkMemoryRequirements memRequirements;
+      vkGetImageMemoryRequirements(_device, image._textureImage, &memRequirements);
+      memorySize = std::max(memorySize, memRequirements.size);
+      memoryTypeBits &= memRequirements.memoryTypeBits;
+    }
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    // no memory type may suit all the images
+    if (created == count && memoryTypeBits != 0) {
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = memorySize;
+      allocInfo.memoryTypeIndex = utils::findMemoryType(_physicalDevice, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      vkAllocateMemory(_device, &allocInfo, nullptr, &memory);
+    }
+
+    // the images can't share memory, each one gets its own allocation instead
+    if (memory == VK_NULL_HANDLE) {
+      for (uint32_t i = 0; i < created; i++) {
+        ImageVK& image = _images[handles[i].id];
+        vkDestroyImage(_device, image._textureImage, nullptr);
+        image._textureImage = VK_NULL_HANDLE;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        newImage(handles[i], nullptr, 0, descs[i]);
+      }
+      return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      ImageVK& image = _images[handles[i].id];
+      vkBindImageMemory(_device, image._textureImage, memory, 0);
+      image._deviceMemory = i == 0 ? memory : VK_NULL_HANDLE;
+      // content is left undefined, and discarded by each image taking the memory
+      _cmdQueue.imageBarrier(image._textureImage, image._format, VK_IMAGE_LAYOUT_UNDEFINED, image._layout);
+      image.createView(_device);
+
+      if (isBindless())
+        _bindlessHeap.writeImage(_device, handles[i].id, image, _defaultSampler._sampler, descs[i].usage == TextureUsage::STORAGE);
+    }
+  }
+
+  void RenderContextVK::newSampler(SamplerHandle handle, const SamplerDesc& desc) {
+    _samplers[handle.id].create(_device, desc, _maxAnisotropy);
   }
 
   void RenderContextVK::beginDefaultPass() {
+    // compute results may be consumed by any stage of the pass
+    if (_computeWritesPending) {
+      _cmdQueue.memoryBarrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        COMPUTE_CONSUMER_STAGES, COMPUTE_CONSUMER_ACCESS
+      );
+      _computeWritesPending = false;
+    }
+
+    _passExtent = _swapChain._extent;
     _cmdQueue.beginPass(
       _defaultPass._renderPass,
       _swapChain._framebuffers[_swapChain._currentImageIdx]._framebuffer,
-      _swapChain._extent
+      _passExtent,
+      _defaultPass._clearValues,
+      _defaultPass._attachmentCount
     );
   }
 
   void RenderContextVK::beginPass(PassHandle pass) {
+    if (_computeWritesPending) {
+      _cmdQueue.memoryBarrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        COMPUTE_CONSUMER_STAGES, COMPUTE_CONSUMER_ACCESS
+      );
+      _computeWritesPending = false;
+    }
+
+    const PassVK& passVK = _passes[pass.id];
+    _passExtent = passVK._extent;
     _cmdQueue.beginPass(
-      _passes[pass.id]._renderPass,
-      _swapChain._framebuffers[_swapChain._currentImageIdx]._framebuffer,
-      _swapChain._extent
+      passVK._renderPass,
+      passVK._framebuffer._framebuffer,
+      _passExtent,
+      passVK._clearValues,
+      passVK._attachmentCount
     );
   }
 
   void RenderContextVK::applyPipeline(PipelineHandle pipe) {
+    const PipelineVK& pipeline = _pipelines[pipe.id];
+    // pipelines which failed to build or validate skip their draws and dispatches
+    _pipelineValid = pipeline._graphicsPipeline != VK_NULL_HANDLE || pipeline._computePipeline != VK_NULL_HANDLE;
+    if (!_pipelineValid)
+      return;
+    _currentProgram = pipeline._desc.program;
+
+    if (pipeline._bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) {
+      // compute pipelines have no raster state nor viewport
+      _cmdQueue.bindPipeline(pipeline._computePipeline, VK_PIPELINE_BIND_POINT_COMPUTE);
+      return;
+    }
+
     _cmdQueue.applyPipeline(
-      _pipelines[pipe.id]._graphicsPipeline,
-      _swapChain._extent
+      pipeline._graphicsPipeline,
+      _passExtent
     );
 
     _currentPipeline = pipe;
+    _boundPipeline = pipeline._graphicsPipeline;
+    _rasterState.cullMode = pipeline._desc.cullMode;
+    _rasterState.faceWinding = pipeline._desc.faceWinding;
+    _rasterState.primitive = pipeline._desc.primitive;
+    // dynamic states have to be set for each pipeline
+    _rasterStateDirty = _features.extendedDynamicState;
+  }
+
+  void RenderContextVK::setCullMode(CullMode mode) {
+    _rasterState.cullMode = mode;
+    _rasterStateDirty = true;
+  }
+
+  void RenderContextVK::setFaceWinding(FaceWinding faceWinding) {
+    _rasterState.faceWinding = faceWinding;
+    _rasterStateDirty = true;
+  }
+
+  void RenderContextVK::setPrimitiveType(PrimitiveType primitive) {
+    _rasterState.primitive = primitive;
+    _rasterStateDirty = true;
+  }
+
+  void RenderContextVK::flushRasterState() {
+    if (!_rasterStateDirty)
+      return;
+
+    // without dynamic state, overrides are handled by pipeline variants
+    VkPipeline variant = _pipelines[_currentPipeline.id].getVariant(_device, _pipelineCache, _rasterState);
+    if (variant != _boundPipeline) {
+      _cmdQueue.bindPipeline(variant);
+      _boundPipeline = variant;
+    }
+
+    if (_features.extendedDynamicState) {
+      _cmdQueue.setRasterState(
+        utils::toVkCullModeFlagBits(_rasterState.cullMode),
+        utils::toVkFrontFace(_rasterState.faceWinding),
+        utils::toVkPrimitiveTopology(_rasterState.primitive)
+      );
+    }
+
+    _rasterStateDirty = false;
   }
 
   void RenderContextVK::endPass() {
     _cmdQueue.endPass();
   }
 
-  void RenderContextVK::draw(uint32_t firstVertex, uint32_t vertexCount) {
-    for (uint32_t i = 0; i < _currentUniformBufferId; i++) {
-      _uniformBuffers[_currentUniformBufferId].createDescriptorSets(_device, _descriptorPool, _shaders[_currentVertexShader.id]._descriptorSetLayout, _cmdQueue._currentFrame);
-      _cmdQueue.bindDescriptorSets(_pipelines[_currentPipeline.id]._pipelineLayout, _uniformBuffers[i]._descriptorSets);
+  void RenderContextVK::barrier(const ResourceBarrier* barriers, uint32_t count) {
+    // images stay in their resting layout between passes, only discarded content goes through the undefined layout
+    for (uint32_t i = 0; i < count; i++) {
+      const ResourceBarrier& barrier = barriers[i];
+      VkPipelineStageFlags2 srcStages, dstStages;
+      VkAccessFlags2 srcAccess, dstAccess;
+      utils::getResourceStateSync(barrier.before, srcStages, srcAccess);
+      utils::getResourceStateSync(barrier.after, dstStages, dstAccess);
+
+      if (barrier.image.id != nullHandle) {
+        const ImageVK& image = _images[barrier.image.id];
+        VkImageLayout oldLayout = barrier.discard ? VK_IMAGE_LAYOUT_UNDEFINED : image._layout;
+        _cmdQueue.imageBarrier(image._textureImage, image._format, oldLayout, image._layout, srcStages, srcAccess, dstStages, dstAccess);
+      }
+      else if (barrier.buffer.id != nullHandle) {
+        _cmdQueue.bufferBarrier(_buffers[barrier.buffer.id]._buffer, 0, VK_WHOLE_SIZE, srcStages, srcAccess, dstStages, dstAccess);
+      }
+    }
+  }
+
+  void RenderContextVK::bindDescriptors(VkPipelineBindPoint bindPoint) {
+    const ProgramVK& program = _programs[_currentProgram.id];
+    uint32_t frame = _cmdQueue._currentFrame;
+
+    // the heap stays bound as long as the pipeline layouts are compatible
+    VkPipelineLayout& bindlessBoundLayout = _bindlessBoundLayouts[bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0];
+    if (bindlessBoundLayout != program._pipelineLayout)
+      bindlessBoundLayout = VK_NULL_HANDLE;
+
+    for (uint32_t set = 0; set < program._setLayoutCount; set++) {
+      if (set == BINDLESS_SET && program._usesBindless) {
+        if (bindlessBoundLayout == VK_NULL_HANDLE) {
+          _cmdQueue.bindDescriptorSet(bindPoint, program._pipelineLayout, set, _bindlessHeap._set);
+          bindlessBoundLayout = program._pipelineLayout;
+        }
+        continue;
+      }
+
+      // infos have to outlive the update call
+      VkDescriptorBufferInfo bufferInfos[MAX_STORAGE_BIND + 1];
+      VkDescriptorImageInfo imageInfos[MAX_STORAGE_BIND + MAX_IMAGE_BIND];
+      VkWriteDescriptorSet writes[MAX_STORAGE_BIND + MAX_IMAGE_BIND + 1]; // bindings are unique within a set
+      uint32_t bufferCount = 0;
+      uint32_t imageCount = 0;
+      uint32_t writeCount = 0;
+
+      for (const ShaderBinding& shaderBinding : program._bindings) {
+        if (shaderBinding.set != set)
+          continue;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstBinding = shaderBinding.binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = utils::toVkDescriptorType(shaderBinding.type);
+
+        // storage slot i feeds the resource declared with binding = i
+        uint32_t slot = shaderBinding.binding;
+        if (shaderBinding.type == ShaderResourceType::UNIFORM_BUFFER) {
+          // latest applyUniforms data, the range is selected by the dynamic offset.
+          // Before any data the descriptor still has to be valid, the shader reads undefined values like in GL
+          if (set != 0 || shaderBinding.binding != program._uniformBinding)
+            continue;
+          write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+          bufferInfos[bufferCount] = { _uniformRings[frame]._buffer, 0, _uniformSize > 0 ? _uniformSize : _uniformDefaultRange };
+          write.pBufferInfo = &bufferInfos[bufferCount++];
+        }
+        else if (shaderBinding.type == ShaderResourceType::STORAGE_BUFFER) {
+          if (slot >= MAX_STORAGE_BIND || _currentBindings.storageBuffers[slot].id == nullHandle)
+            continue;
+          const BufferVK& buffer = _buffers[_currentBindings.storageBuffers[slot].id];
+          bufferInfos[bufferCount] = { buffer._buffer, buffer.getOffset(), buffer._sliceSize };
+          write.pBufferInfo = &bufferInfos[bufferCount++];
+        }
+        else if (shaderBinding.type == ShaderResourceType::STORAGE_IMAGE) {
+          if (slot >= MAX_STORAGE_BIND || _currentBindings.storageImages[slot].id == nullHandle)
+            continue;
+          imageInfos[imageCount] = { VK_NULL_HANDLE, _images[_currentBindings.storageImages[slot].id]._imageView, VK_IMAGE_LAYOUT_GENERAL };
+          write.pImageInfo = &imageInfos[imageCount++];
+        }
+        else if (shaderBinding.type == ShaderResourceType::SAMPLED_IMAGE) {
+          if (slot >= MAX_IMAGE_BIND || _currentBindings.images[slot].id == nullHandle)
+            continue;
+          const ImageVK& image = _images[_currentBindings.images[slot].id];
+          SamplerHandle sampler = _currentBindings.samplers[slot];
+          imageInfos[imageCount] = {
+            sampler.id != nullHandle ? _samplers[sampler.id]._sampler : _defaultSampler._sampler,
+            image._imageView,
+            image._layout
+          };
+          write.pImageInfo = &imageInfos[imageCount++];
+        }
+        else {
+          continue; // separate images and samplers are not bindable
+        }
+
+        writes[writeCount++] = write;
+      }
+
+      // draws with the same resources share their set
+      DescriptorSetKeyVK key;
+      key.layout = program._setLayouts[set];
+      for (uint32_t i = 0; i < writeCount; i++) {
+        DescriptorSetKeyVK::Descriptor& descriptor = key.descriptors[key.descriptorCount++];
+        descriptor.binding = writes[i].dstBinding;
+        if (writes[i].pBufferInfo)
+          descriptor.bufferInfo = *writes[i].pBufferInfo;
+        else
+          descriptor.imageInfo = *writes[i].pImageInfo;
+      }
+
+      DescriptorAllocatorVK& descriptorAllocator = _descriptorAllocators[frame];
+      uint64_t hash = key.hash();
+      const VkDescriptorSet* cachedSet = descriptorAllocator._sets.find(hash, key, std::equal_to<DescriptorSetKeyVK>());
+      VkDescriptorSet descriptorSet = cachedSet ? *cachedSet : VK_NULL_HANDLE;
+      if (descriptorSet == VK_NULL_HANDLE) {
+        descriptorSet = descriptorAllocator.allocate(_device, program._setLayouts[set]);
+        if (descriptorSet == VK_NULL_HANDLE)
+          return; // todo error handling
+
+        for (uint32_t i = 0; i < writeCount; i++)
+          writes[i].dstSet = descriptorSet;
+        if (writeCount > 0)
+          vkUpdateDescriptorSets(_device, writeCount, writes, 0, nullptr);
+        descriptorAllocator._sets.insert(hash, key, descriptorSet);
+      }
+
+      // the layout of the first set has one dynamic uniform buffer if the program uses applyUniforms data
+      if (set == 0 && program._uniformBinding != UINT32_MAX)
+        _cmdQueue.bindDescriptorSet(bindPoint, program._pipelineLayout, set, descriptorSet, 1, &_uniformOffset);
+      else
+        _cmdQueue.bindDescriptorSet(bindPoint, program._pipelineLayout, set, descriptorSet);
+    }
+  }
+
+  void RenderContextVK::draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) {
+    if (!_pipelineValid)
+      return;
+    flushRasterState();
+    bindDescriptors(VK_PIPELINE_BIND_POINT_GRAPHICS);
+    _graphicsWritesPending |= _programs[_currentProgram.id]._writesStorage;
+
+    _cmdQueue.draw(firstVertex, vertexCount, instanceCount, firstInstance);
+  }
+
+  void RenderContextVK::drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) {
+    if (!_pipelineValid)
+      return;
+    flushRasterState();
+    bindDescriptors(VK_PIPELINE_BIND_POINT_GRAPHICS);
+    _graphicsWritesPending |= _programs[_currentProgram.id]._writesStorage;
+
+    _cmdQueue.drawIndexed(firstIndex, indexCount, instanceCount, firstInstance, baseVertex);
+  }
+
+  void RenderContextVK::drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    submitIndirect(buffer, offset, drawCount, countBuffer, countOffset, false);
+  }
+
+  void RenderContextVK::drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) {
+    // rejected as with OpenGL, which can't offset the indices of indirect draws
+    if (_currentBindings.indexBufferOffset != 0 || _buffers[_currentBindings.indexBuffer.id]._sliceCount > 1)
+      return; // todo error handling
+    submitIndirect(buffer, offset, drawCount, countBuffer, countOffset, true);
+  }
+
+  void RenderContextVK::submitIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset, bool indexed) {
+    if (!_pipelineValid)
+      return;
+    flushRasterState();
+    bindDescriptors(VK_PIPELINE_BIND_POINT_GRAPHICS);
+    _graphicsWritesPending |= _programs[_currentProgram.id]._writesStorage;
+
+    const BufferVK& args = _buffers[buffer.id];
+    VkBuffer argBuffer = args._buffer;
+    offset += args.getOffset();
+
+    if (countBuffer.id != nullHandle && _features.drawIndirectCount) {
+      const BufferVK& count = _buffers[countBuffer.id];
+      _cmdQueue.drawIndirectCount(argBuffer, offset, count._buffer, count.getOffset() + countOffset, drawCount, indexed);
+      return;
     }
 
-    _cmdQueue.draw(firstVertex, vertexCount);
+    // without count support, the max draw count is used: unused arguments must have an instance count of 0
+    if (_features.multiDrawIndirect) {
+      _cmdQueue.drawIndirect(argBuffer, offset, drawCount, indexed);
+      return;
+    }
+
+    // one draw per indirect command
+    uint32_t stride = indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+    for (uint32_t i = 0; i < drawCount; i++) {
+      _cmdQueue.drawIndirect(argBuffer, offset + i * stride, 1, indexed);
+    }
   }
 
-  void RenderContextVK::drawIndexed(uint32_t firstIndex, uint32_t indexCount) {
-    for (uint32_t i = 0; i < _currentUniformBufferId; i++) {
-      _uniformBuffers[i].createDescriptorSets(_device, _descriptorPool, _shaders[_currentVertexShader.id]._descriptorSetLayout, _cmdQueue._currentFrame);
-      _cmdQueue.bindDescriptorSets(_pipelines[_currentPipeline.id]._pipelineLayout, _uniformBuffers[i]._descriptorSets);
+  void RenderContextVK::prepareDispatch() {
+    // storage resources written by previous draws or dispatches
+    if (_graphicsWritesPending) {
+      _cmdQueue.memoryBarrier(
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT
+      );
+      _graphicsWritesPending = false;
+    }
+    if (_computeWritesPending) {
+      _cmdQueue.memoryBarrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT
+      );
+      _computeWritesPending = false;
     }
 
-    _cmdQueue.drawIndexed(firstIndex, indexCount);
+    bindDescriptors(VK_PIPELINE_BIND_POINT_COMPUTE);
+    _computeWritesPending |= _programs[_currentProgram.id]._writesStorage;
+  }
+
+  void RenderContextVK::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    if (!_pipelineValid)
+      return;
+    prepareDispatch();
+    _cmdQueue.dispatch(groupCountX, groupCountY, groupCountZ);
+  }
+
+  void RenderContextVK::dispatchIndirect(BufferHandle buffer, uint32_t offset) {
+    if (!_pipelineValid)
+      return;
+    prepareDispatch();
+    const BufferVK& args = _buffers[buffer.id];
+    _cmdQueue.dispatchIndirect(args._buffer, args.getOffset() + offset);
+  }
+
+  void RenderContextVK::fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) {
+    const BufferVK& target = _buffers[buffer.id];
+    VkDeviceSize fillOffset = target.getOffset() + offset;
+
+    // previous reads and writes of the range, including the ones of frames still in flight
+    _cmdQueue.bufferBarrier(
+      target._buffer, fillOffset, size,
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | COMPUTE_CONSUMER_STAGES, VK_ACCESS_2_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT
+    );
+
+    _cmdQueue.fillBuffer(target._buffer, fillOffset, size, value);
+
+    // recorded with the barriers of the next pass or dispatch
+    _cmdQueue.bufferBarrier(
+      target._buffer, fillOffset, size,
+      VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | COMPUTE_CONSUMER_STAGES, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | COMPUTE_CONSUMER_ACCESS
+    );
   }
 
   void RenderContextVK::commitFrame() {
@@ -418,13 +1190,30 @@ namespace jgfx::vk {
     _swapChain.present();
 
     // starts a new frame
+    uint32_t previousFrame = _cmdQueue._currentFrame;
     _cmdQueue.newFrame(_device);
 
-    for (uint32_t i = 0; i < _currentUniformBufferId; i++) {
-      vkFreeDescriptorSets(_device, _descriptorPool, 1, &_uniformBuffers[i]._descriptorSets[_cmdQueue._currentFrame]);
+    // the application samples its input once the previous frame is on screen, or at least rendered
+    if (_lowLatency) {
+      if (_swapChain._waitForPresent)
+        _swapChain.waitForPresent(_device, _swapChain._presentId - 1);
+      else if (_cmdQueue._submittedValue > 1)
+        _cmdQueue.wait(_device, _cmdQueue._submittedValue - 1);
     }
 
-    _currentUniformBufferId = 0;
+    // the frame which used these sets is over
+    _descriptorAllocators[_cmdQueue._currentFrame].reset(_device);
+
+    // the frame which used this ring is over.
+    // Uniforms stay bound until replaced like in GL, the latest data is carried over from the previous ring
+    _uniformRingOffset = 0;
+    if (_uniformSize > 0) {
+      memmove(_uniformRings[_cmdQueue._currentFrame]._mapped, _uniformRings[previousFrame]._mapped + _uniformOffset, _uniformSize);
+      _uniformOffset = 0;
+      _uniformRingOffset = _uniformSize;
+    }
+    _bindlessBoundLayouts[0] = VK_NULL_HANDLE;
+    _bindlessBoundLayouts[1] = VK_NULL_HANDLE;
 
     if (_swapChain._needRecreation)
       _swapChain.update(_device, _physicalDevice, _defaultPass._renderPass);
@@ -436,19 +1225,78 @@ namespace jgfx::vk {
   }
 
   void RenderContextVK::applyBindings(const Bindings& bindings) {
+    // storage resources and images are written to descriptor sets at draw or dispatch time
+    _currentBindings = bindings;
+
+    // consecutive vertex buffers are bound with a single call
     VkBuffer vertexBuffers[MAX_BUFFER_BIND];
-    for (int i = 0; i < MAX_BUFFER_BIND; i++) {
-      vertexBuffers[i] = _buffers[bindings.vertexBuffers[i].id]._buffer;
+    VkDeviceSize offsets[MAX_BUFFER_BIND];
+    uint32_t firstBinding = 0;
+    uint32_t bindingCount = 0;
+    for (uint32_t i = 0; i <= MAX_BUFFER_BIND; i++) {
+      if (i < MAX_BUFFER_BIND && bindings.vertexBuffers[i].id != nullHandle) {
+        if (bindingCount == 0)
+          firstBinding = i;
+        const BufferVK& buffer = _buffers[bindings.vertexBuffers[i].id];
+        vertexBuffers[bindingCount] = buffer._buffer;
+        offsets[bindingCount] = buffer.getOffset() + bindings.vertexBufferOffsets[i];
+        bindingCount++;
+      }
+      else if (bindingCount > 0) {
+        _cmdQueue.bindVertexBuffers(firstBinding, bindingCount, vertexBuffers, offsets);
+        bindingCount = 0;
+      }
     }
-    VkDeviceSize offsets[] = { 0 };
 
-    _cmdQueue.bindVertexBuffers(0, 1, vertexBuffers);
-    _cmdQueue.bindIndexBuffer(_buffers[bindings.indexBuffer.id]._buffer);
+    if (bindings.indexBuffer.id != nullHandle) {
+      const BufferVK& buffer = _buffers[bindings.indexBuffer.id];
+      _cmdQueue.bindIndexBuffer(buffer._buffer, buffer.getOffset() + bindings.indexBufferOffset, utils::toVkIndexType(bindings.indexType));
+    }
   }
 
   void RenderContextVK::applyUniforms(ShaderStage stage, const void* data, uint32_t size) {
-    _uniformBuffers[_currentUniformBufferId].update(data, size, _cmdQueue._currentFrame);
-    _currentUniformBufferId++;
+    if (size > UNIFORM_BUFFER_SIZE)
+      return; // todo error handling
+
+    // each call gets its own range so that previous draws keep their data, draws select it with the dynamic offset
+    uint32_t offset = (_uniformRingOffset + _uniformAlignment - 1) / _uniformAlignment * _uniformAlignment;
+    if (offset + size > _uniformRings[_cmdQueue._currentFrame]._size) {
+      if (!growUniformRing(_cmdQueue._currentFrame, offset + size))
+        return; // todo error handling
+      offset = 0;
+    }
+
+    BufferVK& uniformRing = _uniformRings[_cmdQueue._currentFrame];
+    memcpy(uniformRing._mapped + offset, data, size);
+    _uniformRingOffset = offset + size;
+    _uniformOffset = offset;
+    _uniformSize = size;
+  }
+
+  bool RenderContextVK::growUniformRing(uint32_t frame, uint32_t size) {
+    BufferVK& uniformRing = _uniformRings[frame];
+    BufferVK newRing;
+    void* mapped = nullptr;
+    if (!newRing.create(
+      _device,
+      _physicalDevice,
+      std::max({ size, uniformRing._size * 2, UNIFORM_RING_FRAME_SIZE }),
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      &mapped)
+    ) {
+      newRing.destroy(_device);
+      return false;
+    }
+    newRing._mapped = static_cast<uint8_t*>(mapped);
+
+    // draws recorded earlier in the frame still read the previous ring
+    if (uniformRing._buffer != VK_NULL_HANDLE) {
+      _cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_BUFFER, uint64_t(uniformRing._buffer));
+      _cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(uniformRing._memory));
+    }
+    uniformRing = newRing;
+    return true;
   }
 
   bool SwapChainVK::createSwapChain(VkDevice device, VkPhysicalDevice physicalDevice, const Resolution& resolution) {
@@ -458,7 +1306,7 @@ namespace jgfx::vk {
     // choose form
     VkSurfaceFormatKHR surfaceFormat = utils::chooseSwapSurfaceFormat(swapChainSupport.formats);
     // choose present mode
-    VkPresentModeKHR presentMode = utils::chooseSwapPresentMode(swapChainSupport.presentModes);
+    VkPresentModeKHR presentMode = utils::chooseSwapPresentMode(swapChainSupport.presentModes, _presentMode);
     // choose extent
     VkExtent2D extent = utils::chooseSwapExtent(swapChainSupport.capabilities, resolution);
 
@@ -503,6 +1351,7 @@ namespace jgfx::vk {
     if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &_swapChain) != VK_SUCCESS) {
       return false;
     }
+    _presentId = 0;
 
     // retrieve swapchain's images
     // get image count
@@ -570,15 +1419,63 @@ namespace jgfx::vk {
     return true;
   }
 
+  bool SwapChainVK::createDepthImage(VkDevice device, VkPhysicalDevice physicalDevice) {
+    _depthFormat = utils::findDepthFormat(physicalDevice);
+
+    // no layout transition needed, the default pass clears it from an undefined layout
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { _extent.width, _extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = _depthFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &_depthImage) != VK_SUCCESS)
+      return false;
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, _depthImage, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = utils::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &_depthMemory) != VK_SUCCESS)
+      return false;
+
+    vkBindImageMemory(device, _depthImage, _depthMemory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _depthImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = _depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    return vkCreateImageView(device, &viewInfo, nullptr, &_depthImageView) == VK_SUCCESS;
+  }
+
   bool SwapChainVK::createFramebuffers(VkDevice device, VkRenderPass renderPass) {
     // Create framebuffer for each image
     _framebuffers.resize(_images.size());
     for (size_t i = 0; i < _images.size(); i++) {
       VkImageView attachments[] = {
-        _imageViews[i]
+        _imageViews[i],
+        _depthImageView
       };
 
-      if (!_framebuffers[i].create(device, attachments, _extent, renderPass))
+      if (!_framebuffers[i].create(device, attachments, 2, _extent, renderPass))
         return false;
     }
 
@@ -593,6 +1490,9 @@ namespace jgfx::vk {
     for (auto imageView : _imageViews) {
       vkDestroyImageView(device, imageView, nullptr);
     }
+    vkDestroyImageView(device, _depthImageView, nullptr);
+    vkDestroyImage(device, _depthImage, nullptr);
+    vkFreeMemory(device, _depthMemory, nullptr);
     vkDestroySwapchainKHR(device, _swapChain, nullptr);
   }
 
@@ -604,6 +1504,7 @@ namespace jgfx::vk {
     destroy(device);
     createSwapChain(device, physicalDevice, _resolution);
     createImageViews(device);
+    createDepthImage(device, physicalDevice);
     createFramebuffers(device, renderPass);
 
     _needRecreation = false;
@@ -631,6 +1532,17 @@ namespace jgfx::vk {
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &_currentImageIdx;
 
+    // identifies the presentation, for waitForPresent
+    VkPresentIdKHR presentIdInfo{};
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.swapchainCount = 1;
+    uint64_t presentId = _presentId + 1;
+    presentIdInfo.pPresentIds = &presentId;
+    if (_waitForPresent) {
+      presentInfo.pNext = &presentIdInfo;
+      _presentId = presentId;
+    }
+
     // submit request to present image to the swap chain
     VkResult result = vkQueuePresentKHR(_presentQueue, &presentInfo);
 
@@ -642,11 +1554,22 @@ namespace jgfx::vk {
     }
   }
 
+  void SwapChainVK::waitForPresent(VkDevice device, uint64_t presentId) {
+    // ids restart with a new swap chain
+    if (!_waitForPresent || presentId == 0 || presentId > _presentId)
+      return;
+
+    VkResult result = _waitForPresent(device, _swapChain, presentId, UINT64_MAX);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      _needRecreation = true;
+    }
+  }
+
   void SwapChainVK::setWaitSemaphore(VkSemaphore waitSemaphore) {
     _waitSemaphore = waitSemaphore;
   }
 
-  bool ShaderVK::create(VkDevice device, const void* binData, uint32_t size) {
+  bool ShaderVK::create(VkDevice device, ShaderType type, const void* binData, uint32_t size) {
     // Shader module def
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -658,78 +1581,282 @@ namespace jgfx::vk {
       return false;
     }
 
-    return createDescriptorSetLayout(device);
-  }
-
-  bool ShaderVK::createDescriptorSetLayout(VkDevice device) {
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // TODO: to change with corresponding shader stage
-    uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
-
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
-      return false;
-    }
+    _stage = utils::toVkShaderStage(type);
+    _reflection = reflect(binData, size);
 
     return true;
   }
 
   void ShaderVK::destroy(VkDevice device) {
-    vkDestroyDescriptorSetLayout(device, _descriptorSetLayout, nullptr);
     vkDestroyShaderModule(device, _module, nullptr);
   }
 
-  bool ProgramVK::create(ShaderHandle vs, ShaderHandle fs) {
+  bool ProgramVK::create(VkDevice device, LayoutCacheVK& layoutCache, ShaderHandle vs, ShaderHandle fs, const ShaderVK& vertex, const ShaderVK& fragment) {
     _vs = vs;
     _fs = fs;
 
-    return true;
+    const ShaderVK* shaders[] = { &vertex, &fragment };
+    if (!createLayout(device, layoutCache, shaders, 2))
+      return false;
+
+    _vertexInputs = vertex._reflection.inputs;
+
+    return true;
+  }
+
+  bool ProgramVK::createCompute(VkDevice device, LayoutCacheVK& layoutCache, ShaderHandle cs, const ShaderVK& compute) {
+    _cs = cs;
+
+    const ShaderVK* shaders[] = { &compute };
+    return createLayout(device, layoutCache, shaders, 1);
+  }
+
+  bool ProgramVK::createLayout(VkDevice device, LayoutCacheVK& layoutCache, const ShaderVK* const* shaders, uint32_t shaderCount) {
+    // Merge the bindings of all stages
+    std::vector<VkDescriptorSetLayoutBinding> setBindings[MAX_DESCRIPTOR_SETS];
+    VkPushConstantRange pushConstantRange{};
+    _setLayoutCount = 0;
+    _usesBindless = false;
+    _writesStorage = false;
+    _bindings.clear();
+
+    for (uint32_t s = 0; s < shaderCount; s++) {
+      const ShaderVK* shader = shaders[s];
+      for (const ShaderBinding& shaderBinding : shader->_reflection.bindings) {
+        if (shaderBinding.set >= MAX_DESCRIPTOR_SETS)
+          return false;
+        _writesStorage |= shaderBinding.writable;
+
+        // declared by the shader, but owned by the heap
+        if (shaderBinding.set == BINDLESS_SET && layoutCache._bindlessSetLayout != VK_NULL_HANDLE) {
+          _usesBindless = true;
+          _setLayoutCount = std::max(_setLayoutCount, shaderBinding.set + 1);
+          continue;
+        }
+
+        std::vector<VkDescriptorSetLayoutBinding>& bindings = setBindings[shaderBinding.set];
+        auto it = std::find_if(bindings.begin(), bindings.end(), [&](const VkDescriptorSetLayoutBinding& binding) {
+          return binding.binding == shaderBinding.binding;
+        });
+
+        if (it != bindings.end()) {
+          // same resource used by several stages
+          if (it->descriptorType != utils::toVkDescriptorType(shaderBinding.type))
+            return false;
+          it->stageFlags |= shader->_stage;
+        }
+        else {
+          VkDescriptorSetLayoutBinding binding{};
+          binding.binding = shaderBinding.binding;
+          binding.descriptorType = utils::toVkDescriptorType(shaderBinding.type);
+          binding.descriptorCount = shaderBinding.count;
+          binding.stageFlags = shader->_stage;
+          binding.pImmutableSamplers = nullptr;
+          bindings.push_back(binding);
+          _bindings.push_back(shaderBinding);
+        }
+
+        _setLayoutCount = std::max(_setLayoutCount, shaderBinding.set + 1);
+      }
+
+      if (shader->_reflection.pushConstantSize > 0) {
+        pushConstantRange.stageFlags |= shader->_stage;
+        pushConstantRange.size = std::max(pushConstantRange.size, shader->_reflection.pushConstantSize);
+      }
+    }
+
+    // the uniform buffer receives applyUniforms data, at a dynamic offset in the uniform ring.
+    // Nothing else can be bound to uniform buffers: programs with other ones are rejected instead of reading unwritten descriptors
+    _uniformBinding = UINT32_MAX;
+    for (uint32_t i = 0; i < _setLayoutCount; i++) {
+      for (VkDescriptorSetLayoutBinding& binding : setBindings[i]) {
+        if (binding.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+          continue;
+        if (i != 0 || _uniformBinding != UINT32_MAX)
+          return false; // todo error handling, at most one uniform block, in the first set
+
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        _uniformBinding = binding.binding;
+      }
+    }
+
+    // Descriptor set layouts, unused sets in between get an empty layout
+    for (uint32_t i = 0; i < _setLayoutCount; i++) {
+      if (i == BINDLESS_SET && _usesBindless) {
+        _setLayouts[i] = layoutCache._bindlessSetLayout;
+        continue;
+      }
+
+      std::vector<VkDescriptorSetLayoutBinding>& bindings = setBindings[i];
+      std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
+      });
+
+      _setLayouts[i] = layoutCache.getDescriptorSetLayout(device, bindings.data(), static_cast<uint32_t>(bindings.size()));
+      if (_setLayouts[i] == VK_NULL_HANDLE)
+        return false;
+    }
+
+    _pipelineLayout = layoutCache.getPipelineLayout(
+      device, 
+      _setLayouts, 
+      _setLayoutCount, 
+      &pushConstantRange, 
+      pushConstantRange.size > 0 ? 1 : 0
+    );
+
+    return _pipelineLayout != VK_NULL_HANDLE;
+  }
+
+  bool ProgramVK::validateVertexAttributes(const VertexAttributes& attributes) const {
+    // every input of the vertex shader must be fed by an attribute
+    for (const ShaderInput& input : _vertexInputs) {
+      if (input.location >= MAX_VERTEX_ATTRIBUTES)
+        return false;
+      if (attributes._types[input.location] == UNKNOWN)
+        return false;
+    }
+
+    // attributes have to fit in the stride of their binding
+    for (uint32_t i = 0; i < MAX_VERTEX_ATTRIBUTES; i++) {
+      if (attributes._types[i] == UNKNOWN)
+        continue;
+      if (attributes._offsets[i] + getSizeOf(attributes._types[i]) > attributes._strides[attributes._bindings[i]])
+        return false;
+    }
+
+    return true;
+  }
+
+  bool PipelineVK::create(VkDevice device, PipelineCacheVK& pipelineCache, const ShaderVK& vertex, const ShaderVK& fragment, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc) {
+    _desc = pipelineDesc;
+    _vertexModule = vertex._module;
+    _fragmentModule = fragment._module;
+    _pass = &pass;
+    _pipelineLayout = pipelineLayout;
+    if (_pipelineLayout == VK_NULL_HANDLE || _pass->_renderPass == VK_NULL_HANDLE)
+      return false;
+
+    _graphicsPipeline = pipelineCache.get(device, _vertexModule, _fragmentModule, *_pass, _pipelineLayout, _desc);
+
+    return _graphicsPipeline != VK_NULL_HANDLE;
+  }
+
+  bool PipelineVK::createCompute(VkDevice device, const ShaderVK& compute, VkPipelineLayout pipelineLayout, const ComputePipelineDesc& pipelineDesc) {
+    _desc.program = pipelineDesc.program;
+    _bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    _pipelineLayout = pipelineLayout;
+    if (_pipelineLayout == VK_NULL_HANDLE)
+      return false;
+
+    VkPipelineShaderStageCreateInfo stageInfo{};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = compute._module;
+    stageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = stageInfo;
+    pipelineInfo.layout = _pipelineLayout;
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_computePipeline) != VK_SUCCESS) {
+      return false;
+    }
+
+    return true;
+  }
+
+  void PipelineVK::destroy(VkDevice device) {
+    // graphics pipelines are owned by the pipeline cache
+    if (_computePipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, _computePipeline, nullptr);
+      _computePipeline = VK_NULL_HANDLE;
+    }
+  }
+
+  VkPipeline PipelineVK::getVariant(VkDevice device, PipelineCacheVK& pipelineCache, const RasterState& rasterState) const {
+    PipelineDesc variantDesc = _desc;
+    variantDesc.cullMode = rasterState.cullMode;
+    variantDesc.faceWinding = rasterState.faceWinding;
+    variantDesc.primitive = rasterState.primitive;
+
+    return pipelineCache.get(device, _vertexModule, _fragmentModule, *_pass, _pipelineLayout, variantDesc);
   }
 
-  bool PipelineVK::create(VkDevice device, const ShaderVK& vertex, const ShaderVK& fragment, const PassVK& pass, const PipelineDesc& pipelineDesc) {
+  VkPipeline PipelineCacheVK::get(VkDevice device, VkShaderModule vertexModule, VkShaderModule fragmentModule, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc) {
+    uint64_t key = hashPipelineDesc(pipelineDesc, _dynamicRasterState);
+    auto isSame = [this](const PipelineDesc& a, const PipelineDesc& b) { return isSamePipelineDesc(a, b, _dynamicRasterState); };
+    if (const VkPipeline* cached = _pipelines.find(key, pipelineDesc, isSame))
+      return *cached;
+
+    VkPipeline pipeline = createPipeline(device, vertexModule, fragmentModule, pass, pipelineLayout, pipelineDesc);
+    if (pipeline != VK_NULL_HANDLE)
+      _pipelines.insert(key, pipelineDesc, pipeline);
+
+    return pipeline;
+  }
+
+  void PipelineCacheVK::destroy(VkDevice device) {
+    for (auto& [key, entry] : _pipelines._entries) {
+      vkDestroyPipeline(device, entry.second, nullptr);
+    }
+    _pipelines.clear();
+  }
+
+  VkPipeline PipelineCacheVK::createPipeline(VkDevice device, VkShaderModule vertexModule, VkShaderModule fragmentModule, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc) const {
     // Shader stages:
     // Vertex shader def
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertex._module;
+    vertShaderStageInfo.module = vertexModule;
     vertShaderStageInfo.pName = "main";
 
     // Fragment shader def
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragment._module;
+    fragShaderStageInfo.module = fragmentModule;
     fragShaderStageInfo.pName = "main";
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = pipelineDesc.vertexAttributes._stride;
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    const VertexAttributes& attributes = pipelineDesc.vertexAttributes;
+
+    // one binding per vertex buffer slot used by the attributes
+    VkVertexInputBindingDescription bindingDescriptions[MAX_BUFFER_BIND];
+    uint32_t bindingCount = 0;
+    for (uint32_t i = 0; i < MAX_BUFFER_BIND; i++) {
+      if (attributes._strides[i] == 0)
+        continue;
 
+      bindingDescriptions[bindingCount].binding = i;
+      bindingDescriptions[bindingCount].stride = attributes._strides[i];
+      bindingDescriptions[bindingCount].inputRate = utils::toVkVertexInputRate(attributes._stepRates[i]);
+      bindingCount++;
+    }
+
+    // locations may be sparse, e.g. when a layout only declares the attributes of a depth pass
     VkVertexInputAttributeDescription attrDescriptions[MAX_VERTEX_ATTRIBUTES];
-    for (int i = 0; i < pipelineDesc.vertexAttributes._attrCount; i++) {
-      attrDescriptions[i].binding = 0;
-      attrDescriptions[i].location = i;
-      attrDescriptions[i].format = utils::toVkFormat(pipelineDesc.vertexAttributes._types[i]);
-      attrDescriptions[i].offset = pipelineDesc.vertexAttributes._offsets[i];
+    uint32_t attrCount = 0;
+    for (uint32_t i = 0; i < MAX_VERTEX_ATTRIBUTES; i++) {
+      if (attributes._types[i] == UNKNOWN)
+        continue;
+
+      attrDescriptions[attrCount].binding = attributes._bindings[i];
+      attrDescriptions[attrCount].location = i;
+      attrDescriptions[attrCount].format = utils::toVkFormat(attributes._types[i]);
+      attrDescriptions[attrCount].offset = attributes._offsets[i];
+      attrCount++;
     }
 
     // Vertex input def
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = pipelineDesc.vertexAttributes._attrCount;
+    vertexInputInfo.vertexBindingDescriptionCount = bindingCount;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = attrCount;
     vertexInputInfo.pVertexAttributeDescriptions = attrDescriptions;
 
     // Primitive def
@@ -744,6 +1871,13 @@ namespace jgfx::vk {
       VK_DYNAMIC_STATE_SCISSOR
     };
 
+    // Cull mode, front face and topology are set per draw
+    if (_dynamicRasterState) {
+      dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+      dynamicStates.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+      dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+    }
+
     // Dynamic state def
     VkPipelineDynamicStateCreateInfo dynamicState{};
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -770,44 +1904,58 @@ namespace jgfx::vk {
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = pass._samples;
     multisampling.minSampleShading = 1.0f; // Optional
     multisampling.pSampleMask = nullptr; // Optional
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
-    // Color blending def
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    // Color blending def, the same for every color attachment of the pass
+    VkPipelineColorBlendAttachmentState colorBlendAttachments[MAX_COLOR_ATTACHMENTS];
+    for (uint32_t i = 0; i < pass._colorAttachmentCount; i++) {
+      VkPipelineColorBlendAttachmentState& colorBlendAttachment = colorBlendAttachments[i];
+      colorBlendAttachment = {};
+      colorBlendAttachment.colorWriteMask = utils::toVkColorComponentFlags(pipelineDesc.colorWriteMask);
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+      colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+      colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = pass._colorAttachmentCount;
+    colorBlending.pAttachments = colorBlendAttachments;
     colorBlending.blendConstants[0] = 0.0f; // Optional
     colorBlending.blendConstants[1] = 0.0f; // Optional
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
-    // Pipeline layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &vertex._descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
-      return false;
+    // Depth stencil def, only for passes with a depth attachment
+    const DepthState& depth = pipelineDesc.depth;
+    const StencilState& stencil = pipelineDesc.stencil;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = depth.testEnabled ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = depth.testEnabled && depth.writeEnabled ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = utils::toVkCompareOp(depth.compare);
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = stencil.enabled ? VK_TRUE : VK_FALSE;
+    VkStencilOpState* faces[] = { &depthStencil.front, &depthStencil.back };
+    const StencilFaceState* faceDescs[] = { &stencil.front, &stencil.back };
+    for (uint32_t i = 0; i < 2; i++) {
+      faces[i]->failOp = utils::toVkStencilOp(faceDescs[i]->failOp);
+      faces[i]->passOp = utils::toVkStencilOp(faceDescs[i]->passOp);
+      faces[i]->depthFailOp = utils::toVkStencilOp(faceDescs[i]->depthFailOp);
+      faces[i]->compareOp = utils::toVkCompareOp(faceDescs[i]->compare);
+      faces[i]->compareMask = stencil.readMask;
+      faces[i]->writeMask = stencil.writeMask;
+      faces[i]->reference = stencil.ref;
     }
 
     // Pipeline def
@@ -820,31 +1968,123 @@ namespace jgfx::vk {
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr; // Optional
+    pipelineInfo.pDepthStencilState = pass._hasDepth ? &depthStencil : nullptr;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.layout = _pipelineLayout;
+    pipelineInfo.layout = pipelineLayout;
     pipelineInfo.renderPass = pass._renderPass;
     pipelineInfo.subpass = 0; // which subpass to use
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional. To derive a pass from another.
 
     // Pipeline creation
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS) {
-      return false;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+      return VK_NULL_HANDLE;
     }
 
-    return true;
+    return pipeline;
   }
 
-  void PipelineVK::destroy(VkDevice device) {
-    vkDestroyPipeline(device, _graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
+  VkDescriptorSetLayout LayoutCacheVK::getDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount) {
+    Hasher hasher;
+    for (uint32_t i = 0; i < bindingCount; i++) {
+      hasher.add(bindings[i].binding);
+      hasher.add(bindings[i].descriptorType);
+      hasher.add(bindings[i].descriptorCount);
+      hasher.add(bindings[i].stageFlags);
+    }
+    uint64_t key = hasher.get();
+
+    std::vector<VkDescriptorSetLayoutBinding> bindingKey(bindings, bindings + bindingCount);
+    auto isSame = [](const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b) {
+      if (a.size() != b.size())
+        return false;
+      for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType
+          || a[i].descriptorCount != b[i].descriptorCount || a[i].stageFlags != b[i].stageFlags)
+          return false;
+      }
+      return true;
+    };
+    if (const VkDescriptorSetLayout* cached = _descriptorSetLayouts.find(key, bindingKey, isSame))
+      return *cached;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindingCount;
+    layoutInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+      return VK_NULL_HANDLE;
+    }
+
+    _descriptorSetLayouts.insert(key, bindingKey, setLayout);
+    return setLayout;
+  }
+
+  VkPipelineLayout LayoutCacheVK::getPipelineLayout(VkDevice device, const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangeCount) {
+    // set layouts are unique per content so their handles identify them
+    Hasher hasher;
+    for (uint32_t i = 0; i < setLayoutCount; i++) {
+      hasher.add(uint64_t(setLayouts[i]));
+    }
+    for (uint32_t i = 0; i < pushConstantRangeCount; i++) {
+      hasher.add(pushConstantRanges[i].stageFlags);
+      hasher.add(pushConstantRanges[i].offset);
+      hasher.add(pushConstantRanges[i].size);
+    }
+    uint64_t key = hasher.get();
+
+    PipelineLayoutKey layoutKey;
+    layoutKey.setLayouts.assign(setLayouts, setLayouts + setLayoutCount);
+    layoutKey.pushConstantRanges.assign(pushConstantRanges, pushConstantRanges + pushConstantRangeCount);
+    auto isSame = [](const PipelineLayoutKey& a, const PipelineLayoutKey& b) {
+      if (a.setLayouts != b.setLayouts || a.pushConstantRanges.size() != b.pushConstantRanges.size())
+        return false;
+      for (size_t i = 0; i < a.pushConstantRanges.size(); i++) {
+        const VkPushConstantRange& rangeA = a.pushConstantRanges[i];
+        const VkPushConstantRange& rangeB = b.pushConstantRanges[i];
+        if (rangeA.stageFlags != rangeB.stageFlags || rangeA.offset != rangeB.offset || rangeA.size != rangeB.size)
+          return false;
+      }
+      return true;
+    };
+    if (const VkPipelineLayout* cached = _pipelineLayouts.find(key, layoutKey, isSame))
+      return *cached;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = setLayoutCount;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRangeCount;
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+      return VK_NULL_HANDLE;
+    }
+
+    _pipelineLayouts.insert(key, layoutKey, pipelineLayout);
+    return pipelineLayout;
+  }
+
+  void LayoutCacheVK::destroy(VkDevice device) {
+    for (auto& [key, entry] : _pipelineLayouts._entries) {
+      vkDestroyPipelineLayout(device, entry.second, nullptr);
+    }
+    _pipelineLayouts.clear();
+    for (auto& [key, entry] : _descriptorSetLayouts._entries) {
+      vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+    }
+    _descriptorSetLayouts.clear();
   }
 
-  bool PassVK::create(VkDevice device, VkFormat swapChainImageFormat) {
+  bool PassVK::create(VkDevice device, VkFormat swapChainImageFormat, VkFormat depthFormat) {
     // Attachment def
     // Define the attachment format to use but it do not actualy reference an actual image view
-    VkAttachmentDescription colorAttachment{};
+    VkAttachmentDescription attachments[2] = {};
+    VkAttachmentDescription& colorAttachment = attachments[0];
     colorAttachment.format = swapChainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -854,31 +2094,48 @@ namespace jgfx::vk {
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Image to be presented in the swap chain
 
+    // depth is cleared and never stored, it can stay in tile memory
+    VkAttachmentDescription& depthAttachment = attachments[1];
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     // Reference to framebuffer attachment
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     // Sub pass def
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // graphics subpass
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
     // Subpass dependencies
+    // the depth buffer is shared by the frames, its clear waits for the depth tests of the previous frame
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     // Pass def
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
     renderPassInfo.dependencyCount = 1;
@@ -889,10 +2146,126 @@ namespace jgfx::vk {
       return false;
     }
 
+    _clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+    _clearValues[1].depthStencil = { 1.0f, 0 };
+    _attachmentCount = 2;
+    _hasDepth = true;
+
     return true;
   }
 
+  bool PassVK::create(VkDevice device, const PassDesc& desc, const ImageVK* images) {
+    // attachments are ordered as colors, depth, then resolves
+    VkAttachmentDescription attachments[MAX_PASS_ATTACHMENTS];
+    VkImageView views[MAX_PASS_ATTACHMENTS];
+    VkAttachmentReference colorRefs[MAX_COLOR_ATTACHMENTS];
+    VkAttachmentReference resolveRefs[MAX_COLOR_ATTACHMENTS];
+    VkAttachmentReference depthRef{};
+    bool hasResolve = false;
+    _attachmentCount = 0;
+    _colorAttachmentCount = 0;
+    _hasDepth = false;
+
+    auto addAttachment = [&](const ImageVK& image, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp) {
+      VkAttachmentDescription& attachment = attachments[_attachmentCount];
+      attachment = {};
+      attachment.format = image._format;
+      attachment.samples = image._samples;
+      attachment.loadOp = loadOp;
+      attachment.storeOp = storeOp;
+      attachment.stencilLoadOp = utils::hasStencil(image._format) ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.stencilStoreOp = utils::hasStencil(image._format) ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      // previous content only matters when loaded
+      attachment.initialLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? image._layout : VK_IMAGE_LAYOUT_UNDEFINED;
+      attachment.finalLayout = image._layout;
+      views[_attachmentCount] = image._imageView;
+      return _attachmentCount++;
+    };
+
+    for (uint32_t i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+      const AttachmentDesc& color = desc.colorAttachments[i];
+      if (color.image.id == nullHandle)
+        break;
+
+      const ImageVK& image = images[color.image.id];
+      colorRefs[i].attachment = addAttachment(image, utils::toVkAttachmentLoadOp(color.loadOp), utils::toVkAttachmentStoreOp(color.storeOp));
+      colorRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      _clearValues[colorRefs[i].attachment].color = { { color.clearColor[0], color.clearColor[1], color.clearColor[2], color.clearColor[3] } };
+      _extent = image._extent;
+      _samples = image._samples;
+      _colorAttachmentCount++;
+    }
+
+    if (desc.depthAttachment.image.id != nullHandle) {
+      const AttachmentDesc& depth = desc.depthAttachment;
+      const ImageVK& image = images[depth.image.id];
+      depthRef.attachment = addAttachment(image, utils::toVkAttachmentLoadOp(depth.loadOp), utils::toVkAttachmentStoreOp(depth.storeOp));
+      depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      _clearValues[depthRef.attachment].depthStencil = { depth.clearDepth, depth.clearStencil };
+      _extent = image._extent;
+      _samples = image._samples;
+      _hasDepth = true;
+    }
+
+    for (uint32_t i = 0; i < _colorAttachmentCount; i++) {
+      resolveRefs[i] = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+      if (desc.resolveAttachments[i].id == nullHandle || _samples == VK_SAMPLE_COUNT_1_BIT)
+        continue;
+
+      // fully overwritten by the resolve
+      resolveRefs[i].attachment = addAttachment(images[desc.resolveAttachments[i].id], VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE);
+      resolveRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      hasResolve = true;
+    }
+
+    if (_attachmentCount == 0)
+      return false; // todo error handling
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = _colorAttachmentCount;
+    subpass.pColorAttachments = colorRefs;
+    subpass.pResolveAttachments = hasResolve ? resolveRefs : nullptr;
+    subpass.pDepthStencilAttachment = _hasDepth ? &depthRef : nullptr;
+
+    // previous reads of the attachments by shaders, and attachment writes read by the following shaders
+    const VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    const VkAccessFlags attachmentWrites = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = shaderStages | attachmentStages;
+    dependencies[0].srcAccessMask = attachmentWrites;
+    dependencies[0].dstStageMask = attachmentStages;
+    dependencies[0].dstAccessMask = attachmentWrites | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = attachmentStages;
+    dependencies[1].srcAccessMask = attachmentWrites;
+    dependencies[1].dstStageMask = shaderStages;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = _attachmentCount;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+      return false;
+    }
+
+    return _framebuffer.create(device, views, _attachmentCount, _extent, _renderPass);
+  }
+
   void PassVK::destroy(VkDevice device) {
+    _framebuffer.destroy(device);
     vkDestroyRenderPass(device, _renderPass, nullptr);
   }
 
@@ -929,6 +2302,7 @@ namespace jgfx::vk {
     vkMapMemory(device, _memory, 0, bufferInfo.size, 0, mappedMemory);
 
     _size = size;
+    _usage = usage;
 
     return true;
   }
@@ -937,13 +2311,55 @@ namespace jgfx::vk {
     vkUnmapMemory(device, _memory);
   }
 
+  void BufferVK::update(const void* data, uint32_t size) {
+    if (!_mapped || size > _sliceSize)
+      return; // todo error handling
+
+    // host coherent memory, no flush needed
+    _activeSlice = (_activeSlice + 1) % _sliceCount;
+    memcpy(_mapped + getOffset(), data, size);
+  }
+
+  bool BufferVK::grow(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue) {
+    VkBuffer previousBuffer = _buffer;
+    VkDeviceMemory previousMemory = _memory;
+    uint32_t sliceCount = _sliceCount * 2;
+    _buffer = VK_NULL_HANDLE;
+
+    void* mappedMem;
+    if (!create(device, physicalDevice, _sliceSize * sliceCount, _usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &mappedMem)) {
+      vkDestroyBuffer(device, _buffer, nullptr);
+      _buffer = previousBuffer;
+      _memory = previousMemory;
+      return false;
+    }
+
+    // the recorded commands keep reading the previous buffer
+    cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_BUFFER, uint64_t(previousBuffer));
+    cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(previousMemory));
+
+    // the slices of the new buffer are all free, the next update writes the first one
+    _mapped = static_cast<uint8_t*>(mappedMem);
+    _sliceCount = sliceCount;
+    _activeSlice = sliceCount - 1;
+    _sliceValues.assign(sliceCount, 0);
+    return true;
+  }
+
+  uint32_t BufferVK::getOffset() const {
+    return _activeSlice * _sliceSize;
+  }
+
   void BufferVK::destroy(VkDevice device) {
+    // freeing the memory implicitly unmaps it
     vkDestroyBuffer(device, _buffer, nullptr);
     vkFreeMemory(device, _memory, nullptr);
+    _mapped = nullptr;
   }
 
-  bool UniformBufferVK::create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t size) {
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  bool UniformBufferVK::create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t size, uint32_t framesInFlight) {
+    // one copy per frame in flight, the others stay null
+    for (uint32_t i = 0; i < framesInFlight; i++) {
       if (!_buffers[i].create(
         device,
         physicalDevice,
@@ -970,48 +2386,15 @@ namespace jgfx::vk {
     }
   }
 
-  bool UniformBufferVK::createDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t currentFrame) {
-    std::vector<VkDescriptorSetLayout> layouts(1, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = layouts.data();
-
-    if (vkAllocateDescriptorSets(device, &allocInfo, &_descriptorSets[currentFrame]) != VK_SUCCESS) {
-      return false;
-    }
-
-    //for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-      VkDescriptorBufferInfo bufferInfo{};
-      bufferInfo.buffer = _buffers[currentFrame]._buffer;
-      bufferInfo.offset = 0;
-      bufferInfo.range = _buffers[currentFrame]._size;
-
-      VkWriteDescriptorSet descriptorWrite{};
-      descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrite.dstSet = _descriptorSets[currentFrame];
-      descriptorWrite.dstBinding = 0;
-      descriptorWrite.dstArrayElement = 0;
-      descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrite.descriptorCount = 1;
-      descriptorWrite.pBufferInfo = &bufferInfo;
-
-      vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
-    //}
-
-    return true;
-  }
-
-  bool FramebufferVK::create(VkDevice device, const VkImageView* attachments, VkExtent2D swapChainExtent, VkRenderPass renderPass) {
+  bool FramebufferVK::create(VkDevice device, const VkImageView* attachments, uint32_t attachmentCount, VkExtent2D extent, VkRenderPass renderPass) {
     // Framebuffer def
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = renderPass; // which compatible (same attachments) render pass to use with 
-    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.attachmentCount = attachmentCount;
     framebufferInfo.pAttachments = attachments; // which attachments (aka image views) to use
-    framebufferInfo.width = swapChainExtent.width;
-    framebufferInfo.height = swapChainExtent.height;
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
     framebufferInfo.layers = 1;
 
     //Framebuffer creation
@@ -1024,6 +2407,7 @@ namespace jgfx::vk {
 
   void FramebufferVK::destroy(VkDevice device) {
     vkDestroyFramebuffer(device, _framebuffer, nullptr);
+    _framebuffer = VK_NULL_HANDLE;
   }
 
   void CommandQueueVK::destroy(VkDevice device) {
@@ -1031,6 +2415,7 @@ namespace jgfx::vk {
       vkDestroySemaphore(device, _renderFinishedSemaphores[i], nullptr);
       vkDestroyFence(device, _inFlightFences[i], nullptr);
     }
+    vkDestroySemaphore(device, _timelineSemaphore, nullptr);
     vkDestroyCommandPool(device, _commandPool, nullptr);
   }
 
@@ -1054,7 +2439,7 @@ namespace jgfx::vk {
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = _commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    allocInfo.commandBufferCount = _framesInFlight;
 
     if (vkAllocateCommandBuffers(device, &allocInfo, _commandBuffers) != VK_SUCCESS) {
       return false;
@@ -1070,9 +2455,25 @@ namespace jgfx::vk {
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-      if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device, &fenceInfo, nullptr, &_inFlightFences[i]) != VK_SUCCESS) {
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+      if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &_renderFinishedSemaphores[i]) != VK_SUCCESS) {
+        return false;
+      }
+    }
+
+    if (_waitSemaphores) {
+      VkSemaphoreTypeCreateInfo typeInfo{};
+      typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      typeInfo.initialValue = 0;
+      semaphoreInfo.pNext = &typeInfo;
+
+      return vkCreateSemaphore(device, &semaphoreInfo, nullptr, &_timelineSemaphore) == VK_SUCCESS;
+    }
+
+    // one fence per command buffer instead
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+      if (vkCreateFence(device, &fenceInfo, nullptr, &_inFlightFences[i]) != VK_SUCCESS) {
         return false;
       }
     }
@@ -1092,12 +2493,13 @@ namespace jgfx::vk {
   }
 
   void CommandQueueVK::end() {
+    flushBarriers();
     if (vkEndCommandBuffer(_commandBuffers[_currentFrame]) != VK_SUCCESS) {
       return; // todo error handling
     }
   }
 
-  void CommandQueueVK::beginPass(VkRenderPass pass, VkFramebuffer framebuffer, const VkExtent2D& extent) {
+  void CommandQueueVK::beginPass(VkRenderPass pass, VkFramebuffer framebuffer, const VkExtent2D& extent, const VkClearValue* clearValues, uint32_t clearValueCount) {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = pass;
@@ -1105,10 +2507,11 @@ namespace jgfx::vk {
     renderPassInfo.renderArea.offset = { 0, 0 };
     renderPassInfo.renderArea.extent = extent;
 
-    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} }; // todo: to be parametrized
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    renderPassInfo.clearValueCount = clearValueCount;
+    renderPassInfo.pClearValues = clearValues;
 
+    // barriers can't be recorded inside the pass
+    flushBarriers();
     vkCmdBeginRenderPass(_commandBuffers[_currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
   }
 
@@ -1134,16 +2537,187 @@ namespace jgfx::vk {
     vkCmdSetScissor(_commandBuffers[_currentFrame], 0, 1, &scissor);
   }
 
-  void CommandQueueVK::bindDescriptorSets(VkPipelineLayout pipelineLayout, const VkDescriptorSet* descriptorSets) {
-    vkCmdBindDescriptorSets(_commandBuffers[_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[_currentFrame], 0, nullptr);
+  void CommandQueueVK::bindPipeline(VkPipeline pipeline, VkPipelineBindPoint bindPoint) {
+    vkCmdBindPipeline(_commandBuffers[_currentFrame], bindPoint, pipeline);
+  }
+
+  void CommandQueueVK::setRasterState(VkCullModeFlags cullMode, VkFrontFace frontFace, VkPrimitiveTopology primitiveTopology) {
+    _cmdSetCullMode(_commandBuffers[_currentFrame], cullMode);
+    _cmdSetFrontFace(_commandBuffers[_currentFrame], frontFace);
+    _cmdSetPrimitiveTopology(_commandBuffers[_currentFrame], primitiveTopology);
+  }
+
+  void CommandQueueVK::bindDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex, VkDescriptorSet descriptorSet, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+    vkCmdBindDescriptorSets(_commandBuffers[_currentFrame], bindPoint, pipelineLayout, setIndex, 1, &descriptorSet, dynamicOffsetCount, dynamicOffsets);
+  }
+
+  void CommandQueueVK::draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) {
+    vkCmdDraw(_commandBuffers[_currentFrame], vertexCount, instanceCount, firstVertex, firstInstance);
   }
 
-  void CommandQueueVK::draw(uint32_t firstVertex, uint32_t vertexCount) {
-    vkCmdDraw(_commandBuffers[_currentFrame], vertexCount, 1, firstVertex, 0);
+  void CommandQueueVK::drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) {
+    vkCmdDrawIndexed(_commandBuffers[_currentFrame], indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
   }
 
-  void CommandQueueVK::drawIndexed(uint32_t firstIndex, uint32_t indexCount) {
-    vkCmdDrawIndexed(_commandBuffers[_currentFrame], indexCount, 1, 0, firstIndex, 0);
+  void CommandQueueVK::drawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, bool indexed) {
+    if (indexed)
+      vkCmdDrawIndexedIndirect(_commandBuffers[_currentFrame], buffer, offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+    else
+      vkCmdDrawIndirect(_commandBuffers[_currentFrame], buffer, offset, drawCount, sizeof(VkDrawIndirectCommand));
+  }
+
+  void CommandQueueVK::drawIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, bool indexed) {
+    if (indexed)
+      _cmdDrawIndexedIndirectCount(_commandBuffers[_currentFrame], buffer, offset, countBuffer, countOffset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    else
+      _cmdDrawIndirectCount(_commandBuffers[_currentFrame], buffer, offset, countBuffer, countOffset, maxDrawCount, sizeof(VkDrawIndirectCommand));
+  }
+
+  void CommandQueueVK::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    flushBarriers();
+    vkCmdDispatch(_commandBuffers[_currentFrame], groupCountX, groupCountY, groupCountZ);
+  }
+
+  void CommandQueueVK::dispatchIndirect(VkBuffer buffer, VkDeviceSize offset) {
+    flushBarriers();
+    vkCmdDispatchIndirect(_commandBuffers[_currentFrame], buffer, offset);
+  }
+
+  void CommandQueueVK::memoryBarrier(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess) {
+    _memoryBarrier.srcStageMask |= srcStages;
+    _memoryBarrier.srcAccessMask |= srcAccess;
+    _memoryBarrier.dstStageMask |= dstStages;
+    _memoryBarrier.dstAccessMask |= dstAccess;
+  }
+
+  void CommandQueueVK::bufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess) {
+    VkBufferMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStages;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStages;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    _bufferBarriers.push_back(barrier);
+  }
+
+  void CommandQueueVK::imageBarrier(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
+    // only the stages using the image in each layout are synchronized
+    VkPipelineStageFlags2 srcStages, dstStages;
+    VkAccessFlags2 srcAccess, dstAccess;
+    utils::getLayoutSync(oldLayout, srcStages, srcAccess);
+    utils::getLayoutSync(newLayout, dstStages, dstAccess);
+    imageBarrier(image, format, oldLayout, newLayout, srcStages, srcAccess, dstStages, dstAccess);
+  }
+
+  void CommandQueueVK::imageBarrier(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess) {
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStages;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStages;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = utils::getAspectMask(format);
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    _imageBarriers.push_back(barrier);
+  }
+
+  void CommandQueueVK::flushBarriers() {
+    bool memoryBarrier = _memoryBarrier.srcStageMask != 0 || _memoryBarrier.dstStageMask != 0;
+    if (!memoryBarrier && _bufferBarriers.empty() && _imageBarriers.empty())
+      return;
+
+    if (_cmdPipelineBarrier2) {
+      VkDependencyInfo dependencyInfo{};
+      dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+      dependencyInfo.memoryBarrierCount = memoryBarrier ? 1 : 0;
+      dependencyInfo.pMemoryBarriers = &_memoryBarrier;
+      dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(_bufferBarriers.size());
+      dependencyInfo.pBufferMemoryBarriers = _bufferBarriers.data();
+      dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(_imageBarriers.size());
+      dependencyInfo.pImageMemoryBarriers = _imageBarriers.data();
+
+      _cmdPipelineBarrier2(_commandBuffers[_currentFrame], &dependencyInfo);
+    }
+    else {
+      // legacy barriers share the stage masks of the whole batch
+      VkPipelineStageFlags2 srcStages = _memoryBarrier.srcStageMask;
+      VkPipelineStageFlags2 dstStages = _memoryBarrier.dstStageMask;
+
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = utils::toVkAccessFlags(_memoryBarrier.srcAccessMask);
+      barrier.dstAccessMask = utils::toVkAccessFlags(_memoryBarrier.dstAccessMask);
+
+      std::vector<VkBufferMemoryBarrier> bufferBarriers(_bufferBarriers.size());
+      for (size_t i = 0; i < _bufferBarriers.size(); i++) {
+        const VkBufferMemoryBarrier2& src = _bufferBarriers[i];
+        VkBufferMemoryBarrier& dst = bufferBarriers[i];
+        dst = {};
+        dst.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        dst.srcAccessMask = utils::toVkAccessFlags(src.srcAccessMask);
+        dst.dstAccessMask = utils::toVkAccessFlags(src.dstAccessMask);
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.buffer = src.buffer;
+        dst.offset = src.offset;
+        dst.size = src.size;
+        srcStages |= src.srcStageMask;
+        dstStages |= src.dstStageMask;
+      }
+
+      std::vector<VkImageMemoryBarrier> imageBarriers(_imageBarriers.size());
+      for (size_t i = 0; i < _imageBarriers.size(); i++) {
+        const VkImageMemoryBarrier2& src = _imageBarriers[i];
+        VkImageMemoryBarrier& dst = imageBarriers[i];
+        dst = {};
+        dst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        dst.srcAccessMask = utils::toVkAccessFlags(src.srcAccessMask);
+        dst.dstAccessMask = utils::toVkAccessFlags(src.dstAccessMask);
+        dst.oldLayout = src.oldLayout;
+        dst.newLayout = src.newLayout;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.image = src.image;
+        dst.subresourceRange = src.subresourceRange;
+        srcStages |= src.srcStageMask;
+        dstStages |= src.dstStageMask;
+      }
+
+      // legacy barriers need at least one stage on each side
+      VkPipelineStageFlags srcStageMask = utils::toVkPipelineStageFlags(srcStages);
+      VkPipelineStageFlags dstStageMask = utils::toVkPipelineStageFlags(dstStages);
+      vkCmdPipelineBarrier(
+        _commandBuffers[_currentFrame],
+        srcStageMask ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStageMask ? dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        memoryBarrier ? 1 : 0, &barrier,
+        static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+        static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data()
+      );
+    }
+
+    _memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    _bufferBarriers.clear();
+    _imageBarriers.clear();
+  }
+
+  void CommandQueueVK::fillBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t value) {
+    flushBarriers();
+    vkCmdFillBuffer(_commandBuffers[_currentFrame], buffer, offset, size, value);
   }
 
   void CommandQueueVK::submit() {
@@ -1159,23 +2733,82 @@ namespace jgfx::vk {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &_commandBuffers[_currentFrame];
 
-    // signal on renderFinished semaphore
-    VkSemaphore signalSemaphores[] = { _renderFinishedSemaphores[_currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
+    // signal on renderFinished semaphore, and the timeline with the value of the submission
+    uint64_t value = getRecordingValue();
+    VkSemaphore signalSemaphores[] = { _renderFinishedSemaphores[_currentFrame], _timelineSemaphore };
+    uint64_t signalValues[] = { 0, value }; // ignored for the binary semaphore
+    submitInfo.signalSemaphoreCount = _timelineSemaphore ? 2 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    // will signal inFlightFence when the command queue will finish execution
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    if (_timelineSemaphore)
+      submitInfo.pNext = &timelineInfo;
+
+    // without timeline, will signal inFlightFence when the command queue will finish execution
     if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
       return; // todo error handling
     }
+
+    _submittedValue = value;
+    _frameValues[_currentFrame] = value;
   }
 
   void CommandQueueVK::newFrame(VkDevice device) {
-    // wait to start a new frame
-    vkWaitForFences(device, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
-    vkResetFences(device, 1, &_inFlightFences[_currentFrame]);
+    _currentFrame = (_currentFrame + 1) % _framesInFlight;
+
+    // the command buffer is reused once its last submission is over,
+    // the CPU only waits when it runs _framesInFlight frames ahead
+    wait(device, _frameValues[_currentFrame]);
+    if (!_timelineSemaphore && _frameValues[_currentFrame] != 0)
+      vkResetFences(device, 1, &_inFlightFences[_currentFrame]);
+  }
+
+  uint64_t CommandQueueVK::getRecordingValue() const {
+    return _submittedValue + 1;
+  }
+
+  uint64_t CommandQueueVK::getCompletedValue(VkDevice device) {
+    if (_timelineSemaphore) {
+      _getSemaphoreCounterValue(device, _timelineSemaphore, &_completedValue);
+      return _completedValue;
+    }
+
+    // submissions complete in order, a signaled fence means the previous ones are done too
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+      if (_frameValues[i] > _completedValue && vkGetFenceStatus(device, _inFlightFences[i]) == VK_SUCCESS)
+        _completedValue = _frameValues[i];
+    }
+    return _completedValue;
+  }
+
+  void CommandQueueVK::wait(VkDevice device, uint64_t value) {
+    if (value <= _completedValue || value <= getCompletedValue(device))
+      return;
+    if (value > _submittedValue)
+      return; // todo error handling, would never be reached
+
+    if (_timelineSemaphore) {
+      VkSemaphoreWaitInfo waitInfo{};
+      waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      waitInfo.semaphoreCount = 1;
+      waitInfo.pSemaphores = &_timelineSemaphore;
+      waitInfo.pValues = &value;
+      _waitSemaphores(device, &waitInfo, UINT64_MAX);
+      _completedValue = value;
+      return;
+    }
 
-    _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    // the first submission reaching the value
+    uint32_t frame = _framesInFlight;
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+      if (_frameValues[i] >= value && (frame == _framesInFlight || _frameValues[i] < _frameValues[frame]))
+        frame = i;
+    }
+    vkWaitForFences(device, 1, &_inFlightFences[frame], VK_TRUE, UINT64_MAX);
+    _completedValue = _frameValues[frame];
   }
 
   void CommandQueueVK::setWaitSemaphore(VkSemaphore waitSemaphore) {
@@ -1183,11 +2816,16 @@ namespace jgfx::vk {
   }
 
   void CommandQueueVK::addResourceToRelease(VkObjectType type, uint64_t handle) {
-    _toRelease[_currentFrame].push_back({ type, handle });
+    // used by the commands being recorded
+    _toRelease.push_back({ type, handle, getRecordingValue() });
   }
 
   void CommandQueueVK::releaseResources(VkDevice device) {
-    for (const Resource& resource : _toRelease[_currentFrame]) {
+    // resources of the submissions already executed, without waiting for the others
+    uint64_t completedValue = getCompletedValue(device);
+    size_t releaseCount = 0;
+    while (releaseCount < _toRelease.size() && _toRelease[releaseCount].value <= completedValue) {
+      const Resource& resource = _toRelease[releaseCount++];
       switch (resource.type) {
       case VK_OBJECT_TYPE_BUFFER: vkDestroyBuffer(device, VkBuffer(resource.handle), nullptr); break;
       case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory(device, VkDeviceMemory(resource.handle), nullptr); break;
@@ -1196,30 +2834,90 @@ namespace jgfx::vk {
       }
     }
 
-    _toRelease[_currentFrame].clear();
+    _toRelease.erase(_toRelease.begin(), _toRelease.begin() + releaseCount);
   }
 
-  void CommandQueueVK::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* vertexBuffers) {
-    VkDeviceSize offsets[] = { 0 };
+  void CommandQueueVK::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* vertexBuffers, const VkDeviceSize* offsets) {
     vkCmdBindVertexBuffers(_commandBuffers[_currentFrame], firstBinding, bindingCount, vertexBuffers, offsets);
   }
 
-  void CommandQueueVK::bindIndexBuffer(VkBuffer indexBuffer) {
-    vkCmdBindIndexBuffer(_commandBuffers[_currentFrame], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+  void CommandQueueVK::bindIndexBuffer(VkBuffer indexBuffer, VkDeviceSize offset, VkIndexType indexType) {
+    vkCmdBindIndexBuffer(_commandBuffers[_currentFrame], indexBuffer, offset, indexType);
   }
 
-  bool ImageVK::create(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue, uint32_t width, uint32_t height, const void* data) {
-    uint64_t imageSize = width * height * 4;
+  bool ImageVK::create(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue, const TextureDesc& desc, const void* data) {
+    uint32_t width = desc.width;
+    uint32_t height = desc.height;
+    if (!createImage(device, physicalDevice, desc))
+      return false;
 
-    BufferVK stagingBuffer;
-    void* mappedMem = nullptr;
-    stagingBuffer.create(device, physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &mappedMem);
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, _textureImage, &memRequirements);
 
-    // copy data in mapped memory
-    memcpy(mappedMem, data, static_cast<size_t>(imageSize));
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = utils::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &_deviceMemory) != VK_SUCCESS) {
+      return false;
+    }
+
+    vkBindImageMemory(device, _textureImage, _deviceMemory, 0);
+
+    VkCommandBuffer cmdBuf = cmdQueue._commandBuffers[cmdQueue._currentFrame];
+
+    if (data) {
+      uint64_t imageSize = uint64_t(width) * height * utils::getTexelSize(desc.format);
+
+      BufferVK stagingBuffer;
+      void* mappedMem = nullptr;
+      stagingBuffer.create(device, physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &mappedMem);
+
+      // copy data in mapped memory
+      memcpy(mappedMem, data, static_cast<size_t>(imageSize));
 
-    // unmap memory
-    stagingBuffer.unmapMemory(device);
+      // unmap memory
+      stagingBuffer.unmapMemory(device);
+
+      // transition for copy, recorded along with the barriers pending
+      cmdQueue.imageBarrier(_textureImage, _format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      cmdQueue.flushBarriers();
+
+      // copy staging buffer data to host buffer
+      copyBufferToImage(cmdBuf, stagingBuffer._buffer, 1, _textureImage, width, height);
+
+      // transition for shader access, batched with the following uploads
+      cmdQueue.imageBarrier(_textureImage, _format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _layout);
+
+      cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_BUFFER, uint64_t(stagingBuffer._buffer));
+      cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(stagingBuffer._memory));
+    }
+    else {
+      // content is left undefined, written later by shaders
+      cmdQueue.imageBarrier(_textureImage, _format, VK_IMAGE_LAYOUT_UNDEFINED, _layout);
+    }
+
+    createView(device);
+
+    return true;
+  }
+
+  bool ImageVK::createImage(VkDevice device, VkPhysicalDevice physicalDevice, const TextureDesc& desc) {
+    uint32_t width = desc.width;
+    uint32_t height = desc.height;
+    _format = desc.format == TextureFormat::D24S8 ? utils::findDepthStencilFormat(physicalDevice) : utils::toVkFormat(desc.format);
+    _samples = utils::toVkSampleCount(desc.samples);
+    _extent = { width, height };
+    // storage images stay in the general layout, sampled ones in the shader read only layout.
+    // Render targets come back to it at the end of each pass
+    bool depth = utils::isDepthFormat(desc.format);
+    if (desc.usage == TextureUsage::STORAGE)
+      _layout = VK_IMAGE_LAYOUT_GENERAL;
+    else if (depth)
+      _layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    else
+      _layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1229,52 +2927,234 @@ namespace jgfx::vk {
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.format = _format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (desc.usage == TextureUsage::STORAGE)
+      imageInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    if (desc.usage == TextureUsage::RENDER_TARGET)
+      imageInfo.usage |= depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.samples = _samples;
 
     if (vkCreateImage(device, &imageInfo, nullptr, &_textureImage) != VK_SUCCESS) {
       return false;
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, _textureImage, &memRequirements);
+    return true;
+  }
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = utils::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  uint64_t DescriptorSetKeyVK::hash() const {
+    Hasher hasher;
+    hasher.add(layout);
+    for (uint32_t i = 0; i < descriptorCount; i++) {
+      const Descriptor& descriptor = descriptors[i];
+      hasher.add(descriptor.binding);
+      hasher.add(descriptor.bufferInfo.buffer);
+      hasher.add(descriptor.bufferInfo.offset);
+      hasher.add(descriptor.bufferInfo.range);
+      hasher.add(descriptor.imageInfo.sampler);
+      hasher.add(descriptor.imageInfo.imageView);
+      hasher.add(descriptor.imageInfo.imageLayout);
+    }
+    return hasher.get();
+  }
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &_deviceMemory) != VK_SUCCESS) {
+  bool DescriptorSetKeyVK::operator==(const DescriptorSetKeyVK& other) const {
+    if (layout != other.layout || descriptorCount != other.descriptorCount)
       return false;
+
+    for (uint32_t i = 0; i < descriptorCount; i++) {
+      const Descriptor& a = descriptors[i];
+      const Descriptor& b = other.descriptors[i];
+      if (a.binding != b.binding
+        || a.bufferInfo.buffer != b.bufferInfo.buffer || a.bufferInfo.offset != b.bufferInfo.offset || a.bufferInfo.range != b.bufferInfo.range
+        || a.imageInfo.sampler != b.imageInfo.sampler || a.imageInfo.imageView != b.imageInfo.imageView || a.imageInfo.imageLayout != b.imageInfo.imageLayout)
+        return false;
     }
+    return true;
+  }
 
-    vkBindImageMemory(device, _textureImage, _deviceMemory, 0);
+  VkDescriptorSet DescriptorAllocatorVK::allocate(VkDevice device, VkDescriptorSetLayout layout) {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    // moves to the next pool when the current one is exhausted
+    bool emptyPool = false;
+    while (true) {
+      if (_currentPool == _pools.size()) {
+        VkDescriptorPool pool = createPool(device);
+        if (pool == VK_NULL_HANDLE)
+          return VK_NULL_HANDLE;
+        _pools.push_back(pool);
+      }
 
-    VkCommandBuffer cmdBuf = cmdQueue._commandBuffers[cmdQueue._currentFrame];
+      allocInfo.descriptorPool = _pools[_currentPool];
+      VkDescriptorSet descriptorSet;
+      VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+      if (result == VK_SUCCESS)
+        return descriptorSet;
+      if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+        return VK_NULL_HANDLE;
+      // the layout needs more descriptors than a whole pool holds
+      if (emptyPool)
+        return VK_NULL_HANDLE;
+      _currentPool++;
+      emptyPool = true; // pools after the current one hold no set
+    }
+  }
 
-    // transition for copy
-    transitionImageLayout(cmdBuf, _textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  VkDescriptorPool DescriptorAllocatorVK::createPool(VkDevice device) const {
+    VkDescriptorPoolSize poolSizes[] = {
+      { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_SETS },
+      { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, DESCRIPTOR_POOL_SETS },
+      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SETS * MAX_STORAGE_BIND },
+      { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DESCRIPTOR_POOL_SETS * MAX_STORAGE_BIND },
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_SETS * MAX_IMAGE_BIND },
+      { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, DESCRIPTOR_POOL_SETS * MAX_IMAGE_BIND },
+      { VK_DESCRIPTOR_TYPE_SAMPLER, DESCRIPTOR_POOL_SETS * MAX_IMAGE_BIND }
+    };
 
-    // copy staging buffer data to host buffer
-    copyBufferToImage(cmdBuf, stagingBuffer._buffer, 1, _textureImage, width, height);
+    // sets are never freed one by one
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(std::size(poolSizes));
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
 
-    // transition for shader access
-    transitionImageLayout(cmdBuf, _textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+      return VK_NULL_HANDLE;
+    }
 
-    cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_BUFFER, uint64_t(stagingBuffer._buffer));
-    cmdQueue.addResourceToRelease(VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(stagingBuffer._memory));
+    return pool;
+  }
 
-    createView(device);
+  void DescriptorAllocatorVK::reset(VkDevice device) {
+    // only the pools used during the frame hold sets
+    for (uint32_t i = 0; i <= _currentPool && i < _pools.size(); i++)
+      vkResetDescriptorPool(device, _pools[i], 0);
+    _currentPool = 0;
+    _sets.clear();
+  }
 
-    return true;
+  void DescriptorAllocatorVK::destroy(VkDevice device) {
+    for (VkDescriptorPool pool : _pools)
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    _pools.clear();
+    _currentPool = 0;
+    _sets.clear();
+  }
+
+  bool BindlessHeapVK::create(VkDevice device) {
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0] = { BINDLESS_SAMPLED_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_IMAGES, VK_SHADER_STAGE_ALL, nullptr };
+    bindings[1] = { BINDLESS_STORAGE_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_IMAGES, VK_SHADER_STAGE_ALL, nullptr };
+    bindings[2] = { BINDLESS_STORAGE_BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_BUFFERS, VK_SHADER_STAGE_ALL, nullptr };
+
+    // slots of destroyed or not yet created resources are left unwritten
+    const VkDescriptorBindingFlags bindingFlag =
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorBindingFlags bindingFlags[3] = { bindingFlag, bindingFlag, bindingFlag };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(std::size(bindingFlags));
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &_setLayout) != VK_SUCCESS) {
+      return false;
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_IMAGES },
+      { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_IMAGES },
+      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_BUFFERS }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(std::size(poolSizes));
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &_pool) != VK_SUCCESS) {
+      return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_setLayout;
+
+    return vkAllocateDescriptorSets(device, &allocInfo, &_set) == VK_SUCCESS;
+  }
+
+  void BindlessHeapVK::destroy(VkDevice device) {
+    // the set is freed with its pool
+    vkDestroyDescriptorPool(device, _pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, _setLayout, nullptr);
+    _pool = VK_NULL_HANDLE;
+    _setLayout = VK_NULL_HANDLE;
+    _set = VK_NULL_HANDLE;
+  }
+
+  void BindlessHeapVK::writeImage(VkDevice device, uint32_t index, const ImageVK& image, VkSampler sampler, bool storage) {
+    // multisampled images can't be sampled
+    if (image._samples != VK_SAMPLE_COUNT_1_BIT)
+      return;
+
+    VkDescriptorImageInfo imageInfos[2] = {
+      { sampler, image._imageView, image._layout },
+      { VK_NULL_HANDLE, image._imageView, VK_IMAGE_LAYOUT_GENERAL }
+    };
+
+    VkWriteDescriptorSet writes[2]{};
+    for (uint32_t i = 0; i < 2; i++) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].dstSet = _set;
+      writes[i].dstArrayElement = index;
+      writes[i].descriptorCount = 1;
+      writes[i].pImageInfo = &imageInfos[i];
+    }
+    writes[0].dstBinding = BINDLESS_SAMPLED_IMAGE_BINDING;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[1].dstBinding = BINDLESS_STORAGE_IMAGE_BINDING;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    vkUpdateDescriptorSets(device, storage ? 2 : 1, writes, 0, nullptr);
+  }
+
+  void BindlessHeapVK::writeBuffer(VkDevice device, uint32_t index, VkBuffer buffer, VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo = { buffer, 0, range };
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _set;
+    write.dstBinding = BINDLESS_STORAGE_BUFFER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
   }
 
   void ImageVK::destroy(VkDevice device) {
-    vkDestroySampler(device, _sampler, nullptr);
     vkDestroyImageView(device, _imageView, nullptr);
     vkDestroyImage(device, _textureImage, nullptr);
     vkFreeMemory(device, _deviceMemory, nullptr);
@@ -1285,8 +3165,8 @@ namespace jgfx::vk {
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = _textureImage;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.format = _format;
+    viewInfo.subresourceRange.aspectMask = utils::getAspectMask(_format);
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = 1;
     viewInfo.subresourceRange.baseArrayLayer = 0;
@@ -1299,27 +3179,25 @@ namespace jgfx::vk {
     return true;
   }
 
-  bool ImageVK::createSampler(VkDevice device, VkPhysicalDevice physicalDevice) {
+  bool SamplerVK::create(VkDevice device, const SamplerDesc& desc, float maxAnisotropy) {
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.magFilter = utils::toVkFilter(desc.magFilter);
+    samplerInfo.minFilter = utils::toVkFilter(desc.minFilter);
+    samplerInfo.mipmapMode = utils::toVkSamplerMipmapMode(desc.mipmapFilter);
+    samplerInfo.addressModeU = utils::toVkSamplerAddressMode(desc.addressU);
+    samplerInfo.addressModeV = utils::toVkSamplerAddressMode(desc.addressV);
+    samplerInfo.addressModeW = utils::toVkSamplerAddressMode(desc.addressW);
+    // anisotropy needs the samplerAnisotropy feature, maxAnisotropy is 1 without it
+    samplerInfo.maxAnisotropy = std::clamp(desc.maxAnisotropy, 1.0f, maxAnisotropy);
+    samplerInfo.anisotropyEnable = samplerInfo.maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     if (vkCreateSampler(device, &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
       return false;
@@ -1328,6 +3206,11 @@ namespace jgfx::vk {
     return true;
   }
 
+  void SamplerVK::destroy(VkDevice device) {
+    vkDestroySampler(device, _sampler, nullptr);
+    _sampler = VK_NULL_HANDLE;
+  }
+
   void ImageVK::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, uint32_t bufferImageCopyCount, VkImage image, uint32_t width, uint32_t height) {
     VkBufferImageCopy region{};
     region.bufferOffset = 0;
@@ -1356,49 +3239,4 @@ namespace jgfx::vk {
     );
   }
 
-  void ImageVK::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-      barrier.srcAccessMask = 0;
-      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-      sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-      destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-      sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-      destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else {
-      throw std::invalid_argument("unsupported layout transition");
-    }
-
-    vkCmdPipelineBarrier(
-      commandBuffer,
-      sourceStage, destinationStage,
-      0,
-      0, nullptr,
-      0, nullptr,
-      1, &barrier
-    );
-  }
-
 }
\ No newline at end of file
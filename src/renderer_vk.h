@@ -2,7 +2,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include <unordered_map>
+
 #include "renderer.h"
+#include "spirv_reader.h"
+#include "hash.h"
 
 namespace jgfx {
   struct InitInfo;
@@ -10,22 +14,34 @@ namespace jgfx {
 }
 
 namespace jgfx::vk { 
+  constexpr uint32_t MAX_DESCRIPTOR_SETS = 4; // minimum maxBoundDescriptorSets guaranteed by the spec
+  constexpr uint32_t DESCRIPTOR_POOL_SETS = 256; // sets per descriptor pool, pools are added when a frame needs more
+  constexpr uint32_t UNIFORM_BUFFER_SIZE = 64 << 10;
+  constexpr uint32_t UNIFORM_RING_FRAME_SIZE = 1 << 20; // initial size of the applyUniforms data of a frame
+  // stages and accesses which may consume compute shader writes
+  constexpr VkPipelineStageFlags2 COMPUTE_CONSUMER_STAGES = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+  constexpr VkAccessFlags2 COMPUTE_CONSUMER_ACCESS = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+
+  constexpr uint32_t MAX_PASS_ATTACHMENTS = MAX_COLOR_ATTACHMENTS * 2 + 1; // colors, depth and resolves
+
   struct FramebufferVK {
-    bool create(VkDevice device, const VkImageView* attachments, VkExtent2D swapChainExtent, VkRenderPass renderPass);
+    bool create(VkDevice device, const VkImageView* attachments, uint32_t attachmentCount, VkExtent2D extent, VkRenderPass renderPass);
     void destroy(VkDevice device);
-    VkFramebuffer _framebuffer;
+    VkFramebuffer _framebuffer = VK_NULL_HANDLE;
   };
 
   struct SwapChainVK {
     bool createSwapChain(VkDevice device, VkPhysicalDevice physicalDevice, const Resolution& resolution);
     bool createSurface(VkInstance instance, const PlatformData& platformData);
     bool createImageViews(VkDevice device);
+    bool createDepthImage(VkDevice device, VkPhysicalDevice physicalDevice);
     bool createFramebuffers(VkDevice device, VkRenderPass renderPass);
     void destroy(VkDevice device);
     void destroySurface(VkInstance instance);
     void update(VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass);
     void acquire(VkDevice device);
     void present();
+    void waitForPresent(VkDevice device, uint64_t presentId);
     void setWaitSemaphore(VkSemaphore waitSemaphore);
     VkSurfaceKHR _surface = VK_NULL_HANDLE;
     VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
@@ -37,57 +53,168 @@ namespace jgfx::vk {
     std::vector<VkImage> _images;
     std::vector<VkImageView> _imageViews;
     std::vector<FramebufferVK> _framebuffers;
+    // depth buffer of the default pass, shared by all swap chain images since it isn't kept between frames
+    VkFormat _depthFormat = VK_FORMAT_UNDEFINED;
+    VkImage _depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory _depthMemory = VK_NULL_HANDLE;
+    VkImageView _depthImageView = VK_NULL_HANDLE;
     uint32_t _currentImageIdx;
     Resolution _resolution;
+    VkPresentModeKHR _presentMode = VK_PRESENT_MODE_MAILBOX_KHR; // requested mode, FIFO when not supported
+    uint64_t _presentId = 0; // id of the last presentation, restarts with the swap chain
+    PFN_vkWaitForPresentKHR _waitForPresent = nullptr; // null when not supported
     bool _needRecreation = false;
   };
 
+  /// <summary>
+  /// Owns descriptor set layouts and pipeline layouts so that identical layouts are created only once
+  /// </summary>
+  struct LayoutCacheVK {
+    VkDescriptorSetLayout getDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount);
+    VkPipelineLayout getPipelineLayout(VkDevice device, const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangeCount);
+    void destroy(VkDevice device);
+    struct PipelineLayoutKey {
+      std::vector<VkDescriptorSetLayout> setLayouts;
+      std::vector<VkPushConstantRange> pushConstantRanges;
+    };
+    HashCache<std::vector<VkDescriptorSetLayoutBinding>, VkDescriptorSetLayout> _descriptorSetLayouts;
+    HashCache<PipelineLayoutKey, VkPipelineLayout> _pipelineLayouts;
+    VkDescriptorSetLayout _bindlessSetLayout = VK_NULL_HANDLE; // layout of BINDLESS_SET, owned by the bindless heap, null when disabled
+  };
+
+  /// <summary>
+  /// Layout and resources written to a descriptor set, identifies the sets shared within a frame
+  /// </summary>
+  struct DescriptorSetKeyVK {
+    struct Descriptor {
+      uint32_t binding = 0;
+      VkDescriptorBufferInfo bufferInfo = {}; // null buffer for images
+      VkDescriptorImageInfo imageInfo = {};
+    };
+    uint64_t hash() const;
+    bool operator==(const DescriptorSetKeyVK& other) const;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    Descriptor descriptors[MAX_STORAGE_BIND + MAX_IMAGE_BIND + 1]; // bindings are unique within a set
+    uint32_t descriptorCount = 0;
+  };
+
+  /// <summary>
+  /// Descriptor sets of one frame in flight, allocated from pools created on demand.
+  /// Pools are reset as a whole once the frame is over, and sets written with the same resources are shared within the frame
+  /// </summary>
+  struct DescriptorAllocatorVK {
+    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
+    VkDescriptorPool createPool(VkDevice device) const;
+    void reset(VkDevice device);
+    void destroy(VkDevice device);
+    std::vector<VkDescriptorPool> _pools;
+    uint32_t _currentPool = 0; // pools before this one are full
+    HashCache<DescriptorSetKeyVK, VkDescriptorSet> _sets; // keyed by layout and written resources
+  };
+
   struct ShaderVK {
-    bool create(VkDevice device, const void* binData, uint32_t size);
-    bool createDescriptorSetLayout(VkDevice device);
+    bool create(VkDevice device, ShaderType type, const void* binData, uint32_t size);
     void destroy(VkDevice device);
-    VkDescriptorSetLayout _descriptorSetLayout; // describes the kind of descriptors that can be bound
     VkShaderModule _module = VK_NULL_HANDLE;
-    VkDescriptorSetLayoutBinding binding;
+    VkShaderStageFlagBits _stage = VK_SHADER_STAGE_VERTEX_BIT;
+    ShaderReflection _reflection; // resources used by the shader
   };
 
+  /// <summary>
+  /// Merges the reflected resources of its shaders into descriptor set layouts and a pipeline layout
+  /// </summary>
   struct ProgramVK {
-    bool create(ShaderHandle vs, ShaderHandle fs);
+    bool create(VkDevice device, LayoutCacheVK& layoutCache, ShaderHandle vs, ShaderHandle fs, const ShaderVK& vertex, const ShaderVK& fragment);
+    bool createCompute(VkDevice device, LayoutCacheVK& layoutCache, ShaderHandle cs, const ShaderVK& compute);
+    bool createLayout(VkDevice device, LayoutCacheVK& layoutCache, const ShaderVK* const* shaders, uint32_t shaderCount);
+    bool validateVertexAttributes(const VertexAttributes& attributes) const;
 
     ShaderHandle _vs;
     ShaderHandle _fs;
+    ShaderHandle _cs;
+    std::vector<ShaderBinding> _bindings; // resources of all stages
+    VkDescriptorSetLayout _setLayouts[MAX_DESCRIPTOR_SETS]; // owned by the layout cache
+    uint32_t _setLayoutCount = 0;
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE; // owned by the layout cache
+    uint32_t _uniformBinding = UINT32_MAX; // binding of the uniform buffer in the first set, with a dynamic offset
+    bool _usesBindless = false; // BINDLESS_SET is the set of the bindless heap
+    bool _writesStorage = false; // a stage writes a storage buffer or image, later dispatches need a barrier
+    std::vector<ShaderInput> _vertexInputs; // inputs expected by the vertex shader
   };
 
+  struct ImageVK;
+
   struct PassVK {
-    bool create(VkDevice device, VkFormat swapChainImageFormat);
+    // swap chain pass, rendering into the swap chain framebuffers
+    bool create(VkDevice device, VkFormat swapChainImageFormat, VkFormat depthFormat);
+    // offscreen pass, attachments go back to the resting layout of their image when the pass ends
+    bool create(VkDevice device, const PassDesc& desc, const ImageVK* images);
     void destroy(VkDevice device);
     VkRenderPass _renderPass = VK_NULL_HANDLE;
+    FramebufferVK _framebuffer; // unused by the default pass
+    VkExtent2D _extent = {};
+    VkSampleCountFlagBits _samples = VK_SAMPLE_COUNT_1_BIT;
+    uint32_t _colorAttachmentCount = 1;
+    bool _hasDepth = false;
+    VkClearValue _clearValues[MAX_PASS_ATTACHMENTS] = {}; // indexed as the attachments
+    uint32_t _attachmentCount = 1;
+  };
+
+  /// <summary>
+  /// Owns the graphics pipelines, created once per pipeline description.
+  /// With dynamic raster state, descriptions differing only by cull mode, face winding or primitive (of the same class) share the same pipeline
+  /// </summary>
+  struct PipelineCacheVK {
+    VkPipeline get(VkDevice device, VkShaderModule vertexModule, VkShaderModule fragmentModule, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc);
+    VkPipeline createPipeline(VkDevice device, VkShaderModule vertexModule, VkShaderModule fragmentModule, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc) const;
+    void destroy(VkDevice device);
+    HashCache<PipelineDesc, VkPipeline> _pipelines;
+    bool _dynamicRasterState = false;
   };
 
   struct PipelineVK {
-    bool create(VkDevice device, const ShaderVK& vertex, const ShaderVK& fragment, const PassVK& pass, const PipelineDesc& pipelineDesc);
+    bool create(VkDevice device, PipelineCacheVK& pipelineCache, const ShaderVK& vertex, const ShaderVK& fragment, const PassVK& pass, VkPipelineLayout pipelineLayout, const PipelineDesc& pipelineDesc);
+    bool createCompute(VkDevice device, const ShaderVK& compute, VkPipelineLayout pipelineLayout, const ComputePipelineDesc& pipelineDesc);
     void destroy(VkDevice device);
-    VkPipeline _graphicsPipeline = VK_NULL_HANDLE;
-    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline getVariant(VkDevice device, PipelineCacheVK& pipelineCache, const RasterState& rasterState) const;
+    PipelineDesc _desc; // only the program is used by compute pipelines
+    VkPipelineBindPoint _bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    VkShaderModule _vertexModule = VK_NULL_HANDLE;
+    VkShaderModule _fragmentModule = VK_NULL_HANDLE;
+    const PassVK* _pass = nullptr; // pass the pipeline renders in
+    VkPipeline _graphicsPipeline = VK_NULL_HANDLE; // shared, owned by the pipeline cache
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE; // shared, owned by the layout cache
+    VkPipeline _computePipeline = VK_NULL_HANDLE; // owned
   };
 
+  struct CommandQueueVK;
+
   struct BufferVK {
     bool create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, void** mappedMemory);
     void unmapMemory(VkDevice device);
+    // writes the next slice of a dynamic or stream buffer
+    void update(const void* data, uint32_t size);
+    // doubles the slices, the previous buffer is released once the commands being recorded are executed
+    bool grow(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue);
+    uint32_t getOffset() const;
     void destroy(VkDevice device);
     VkBuffer _buffer = VK_NULL_HANDLE;
     VkDeviceMemory _memory = VK_NULL_HANDLE;
+    VkBufferUsageFlags _usage = 0;
     uint32_t _size = 0;
+    uint32_t _sliceSize = 0;
+    uint32_t _sliceCount = 1;
+    uint32_t _activeSlice = 0; // slice read by the commands recorded after the last update
+    std::vector<uint64_t> _sliceValues; // submission value after which each slice is no longer read
+    uint8_t* _mapped = nullptr; // persistently mapped, null for static buffers
   };
 
   struct UniformBufferVK {
-    bool create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t size);
+    bool create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t size, uint32_t framesInFlight);
     void update(const void* data, uint32_t size, uint32_t currentFrame);
-    bool createDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t currentFram);
     void destroy(VkDevice device);
     BufferVK _buffers[MAX_FRAMES_IN_FLIGHT];
     void* _mappedMemory[MAX_FRAMES_IN_FLIGHT];
-    VkDescriptorSet _descriptorSets[MAX_FRAMES_IN_FLIGHT];
   };
 
   struct CommandQueueVK {
@@ -97,46 +224,110 @@ namespace jgfx::vk {
     bool createCommandBuffers(VkDevice device);
     bool createSyncObjects(VkDevice device);
     void destroy(VkDevice device);
-    void beginPass(VkRenderPass pass, VkFramebuffer framebuffer, const VkExtent2D& extent);
+    void beginPass(VkRenderPass pass, VkFramebuffer framebuffer, const VkExtent2D& extent, const VkClearValue* clearValues, uint32_t clearValueCount);
     void endPass();
     void applyPipeline(VkPipeline pipeline, const VkExtent2D& extent);
-    void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* vertexBuffers);
-    void bindIndexBuffer(VkBuffer indexBuffe);
-    void bindDescriptorSets(VkPipelineLayout pipelineLayout, const VkDescriptorSet* descriptorSets);
-    void draw(uint32_t firstVertex, uint32_t vertexCount);
-    void drawIndexed(uint32_t firstIndex, uint32_t indexCount);
+    void bindPipeline(VkPipeline pipeline, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+    void setRasterState(VkCullModeFlags cullMode, VkFrontFace frontFace, VkPrimitiveTopology primitiveTopology);
+    void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* vertexBuffers, const VkDeviceSize* offsets);
+    void bindIndexBuffer(VkBuffer indexBuffer, VkDeviceSize offset, VkIndexType indexType);
+    void bindDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex, VkDescriptorSet descriptorSet, uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+    void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance);
+    void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex);
+    void drawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, bool indexed);
+    void drawIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, bool indexed);
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+    void dispatchIndirect(VkBuffer buffer, VkDeviceSize offset);
+    // Barriers are batched and recorded at once before the next pass, dispatch or transfer
+    void memoryBarrier(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+    void bufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+    void imageBarrier(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+    void imageBarrier(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+    void flushBarriers();
+    void fillBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t value);
     void submit();
     void newFrame(VkDevice device);
+    // Submissions signal increasing values, reached in order by the queue
+    uint64_t getRecordingValue() const; // value reached once the commands being recorded are executed
+    uint64_t getCompletedValue(VkDevice device); // doesn't block
+    void wait(VkDevice device, uint64_t value); // only blocks when the value isn't reached yet
     void setWaitSemaphore(VkSemaphore waitSemaphore);
     void addResourceToRelease(VkObjectType type, uint64_t handle);
     void releaseResources(VkDevice device);
     VkCommandPool _commandPool = VK_NULL_HANDLE;
-    VkCommandBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT];
-    VkFence _inFlightFences[MAX_FRAMES_IN_FLIGHT]; // wait for frame ending to start a new one
+    VkCommandBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT] = {};
+    uint32_t _framesInFlight = MAX_FRAMES_IN_FLIGHT; // command buffers used in turn
+    VkFence _inFlightFences[MAX_FRAMES_IN_FLIGHT] = {}; // signaled by the submissions, without timeline semaphore
+    VkSemaphore _timelineSemaphore = VK_NULL_HANDLE; // signaled with the value of each submission
+    uint64_t _submittedValue = 0; // value of the last submission
+    uint64_t _completedValue = 0; // last value known to be reached
+    uint64_t _frameValues[MAX_FRAMES_IN_FLIGHT] = {}; // value of the last submission of each command buffer
     VkQueue _graphicsQueue = VK_NULL_HANDLE; // queue supporting draw operations
-    VkSemaphore _renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT]; // signal that rendering has finished and presentation can happen
+    VkSemaphore _renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT] = {}; // signal that rendering has finished and presentation can happen
     VkSemaphore _waitSemaphore = VK_NULL_HANDLE;
     uint32_t _currentFrame = 0;
 
+    // extended dynamic state functions, null when not supported
+    PFN_vkCmdSetCullModeEXT _cmdSetCullMode = nullptr;
+    PFN_vkCmdSetFrontFaceEXT _cmdSetFrontFace = nullptr;
+    PFN_vkCmdSetPrimitiveTopologyEXT _cmdSetPrimitiveTopology = nullptr;
+    // draw indirect count functions, null when not supported
+    PFN_vkCmdDrawIndirectCountKHR _cmdDrawIndirectCount = nullptr;
+    PFN_vkCmdDrawIndexedIndirectCountKHR _cmdDrawIndexedIndirectCount = nullptr;
+    // synchronization2 barrier function, legacy barriers when not supported
+    PFN_vkCmdPipelineBarrier2KHR _cmdPipelineBarrier2 = nullptr;
+    // timeline semaphore functions, null when not supported
+    PFN_vkGetSemaphoreCounterValueKHR _getSemaphoreCounterValue = nullptr;
+    PFN_vkWaitSemaphoresKHR _waitSemaphores = nullptr;
+
+    // pending barriers, memory barriers are merged into one
+    VkMemoryBarrier2 _memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    std::vector<VkBufferMemoryBarrier2> _bufferBarriers;
+    std::vector<VkImageMemoryBarrier2> _imageBarriers;
+
     struct Resource {
       VkObjectType type;
       uint64_t handle;
+      uint64_t value; // released once this value is reached
     };
 
-    std::vector<Resource> _toRelease[MAX_FRAMES_IN_FLIGHT];
+    std::vector<Resource> _toRelease; // in submission order
   };
 
   struct ImageVK {
-    bool create(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue, uint32_t width, uint32_t height, const void* data);
+    bool create(VkDevice device, VkPhysicalDevice physicalDevice, CommandQueueVK& cmdQueue, const TextureDesc& desc, const void* data);
+    // image without memory
+    bool createImage(VkDevice device, VkPhysicalDevice physicalDevice, const TextureDesc& desc);
     void destroy(VkDevice device);
     bool createView(VkDevice device);
-    bool createSampler(VkDevice device, VkPhysicalDevice physicalDevice);
     void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, uint32_t bufferImageCopyCount, VkImage image, uint32_t width, uint32_t height);
-    void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
     VkImage _textureImage;
-    VkDeviceMemory _deviceMemory;
+    VkDeviceMemory _deviceMemory = VK_NULL_HANDLE; // null for aliased images but the first one, which owns the memory
     VkImageView _imageView;
-    VkSampler _sampler;
+    VkFormat _format = VK_FORMAT_R8G8B8A8_SRGB;
+    VkImageLayout _layout = VK_IMAGE_LAYOUT_UNDEFINED; // resting layout between passes and dispatches, general for storage images
+    VkSampleCountFlagBits _samples = VK_SAMPLE_COUNT_1_BIT;
+    VkExtent2D _extent = {};
+  };
+
+  struct SamplerVK {
+    bool create(VkDevice device, const SamplerDesc& desc, float maxAnisotropy);
+    void destroy(VkDevice device);
+    VkSampler _sampler = VK_NULL_HANDLE;
+  };
+
+  /// <summary>
+  /// Descriptor set indexing all images and static storage buffers with the id of their handle.
+  /// Descriptors are written once when their resource is created, possibly while the set is in use
+  /// </summary>
+  struct BindlessHeapVK {
+    bool create(VkDevice device);
+    void destroy(VkDevice device);
+    void writeImage(VkDevice device, uint32_t index, const ImageVK& image, VkSampler sampler, bool storage);
+    void writeBuffer(VkDevice device, uint32_t index, VkBuffer buffer, VkDeviceSize range);
+    VkDescriptorPool _pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
   };
 
   struct RenderContextVK : public RenderContext {
@@ -144,10 +335,13 @@ namespace jgfx::vk {
     bool init(const InitInfo& createInfo) override;
     void shutdown() override;
     bool pickPhysicalDevice(VkSurfaceKHR surface, const std::vector<const char*>& deviceExtensions);
+    void selectOptionalFeatures(const InitInfo& initInfo, std::vector<const char*>& deviceExtensions);
     bool createLogicalDevice(VkSurfaceKHR surface, const std::vector<const char*>& deviceExtensions);
-    bool createDescriptorPool();
+    void loadDeviceFunctions();
     VkResult createDebugUtilsMessengerEXT(const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator);
     void updateResolution(const Resolution& resolution) override;
+    bool isBindless() const override;
+    bool supportsDrawIndirectCount() const override;
     void createStagingBuffer();
 
     // ObjectVK creation
@@ -155,9 +349,16 @@ namespace jgfx::vk {
     void newPass(PassHandle handle, const PassDesc& passDesc) override;
     void newShader(ShaderHandle handle, ShaderType type, const void* binData, uint32_t size) override;
     void newProgram(ProgramHandle handle, ShaderHandle vs, ShaderHandle fs) override;
-    void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type) override;
+    void newComputeProgram(ProgramHandle handle, ShaderHandle cs) override;
+    void newComputePipeline(PipelineHandle handle, const ComputePipelineDesc& pipelineDesc) override;
+    void newShaders(const ShaderHandle* handles, const ShaderDesc* descs, uint32_t count) override;
+    void newPrograms(const ProgramHandle* handles, const ProgramDesc* descs, uint32_t count) override;
+    void newBuffer(BufferHandle handle, const void* data, uint32_t size, BufferType type, BufferUsage usage) override;
+    void updateBuffer(BufferHandle handle, const void* data, uint32_t size) override;
     void newUniformBuffer(UniformBufferHandle handle, uint32_t size) override;
     void newImage(ImageHandle handle, const void* data, uint32_t size, const TextureDesc& desc) override;
+    void newAliasedImages(const ImageHandle* handles, const TextureDesc* descs, uint32_t count) override;
+    void newSampler(SamplerHandle handle, const SamplerDesc& desc) override;
 
     // cmds
     void beginDefaultPass() override;
@@ -165,26 +366,55 @@ namespace jgfx::vk {
     void applyPipeline(PipelineHandle pipe) override;
     void applyBindings(const Bindings& bindings) override;
     void applyUniforms(ShaderStage stage, const void* data, uint32_t size) override;
-    void draw(uint32_t firstVertex, uint32_t vertexCount) override;
-    void drawIndexed(uint32_t firstIndex, uint32_t indexCount) override;
+    void setCullMode(CullMode mode) override;
+    void setFaceWinding(FaceWinding faceWinding) override;
+    void setPrimitiveType(PrimitiveType primitive) override;
+    void flushRasterState();
+    void bindDescriptors(VkPipelineBindPoint bindPoint);
+    // replaces the ring of a frame with one of at least size bytes
+    bool growUniformRing(uint32_t frame, uint32_t size);
+    void draw(uint32_t firstVertex, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstInstance) override;
+    void drawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t instanceCount, uint32_t firstInstance, int32_t baseVertex) override;
+    void drawIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) override;
+    void drawIndexedIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset) override;
+    void submitIndirect(BufferHandle buffer, uint32_t offset, uint32_t drawCount, BufferHandle countBuffer, uint32_t countOffset, bool indexed);
     void endPass() override;
+    void barrier(const ResourceBarrier* barriers, uint32_t count) override;
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+    void dispatchIndirect(BufferHandle buffer, uint32_t offset) override;
+    void prepareDispatch();
+    void fillBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t value) override;
     void commitFrame() override;
     
   private:
     VkInstance _instance = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT _debugMessenger = VK_NULL_HANDLE;
     VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
-    VkPhysicalDeviceFeatures _physicalDeviceFeatures;
+    VkPhysicalDeviceFeatures _physicalDeviceFeatures{};
+    DeviceFeaturesVK _features;
+    uint32_t _framesInFlight = MAX_FRAMES_IN_FLIGHT;
+    bool _lowLatency = false; // commitFrame waits for the previous frame to be presented
+    float _maxAnisotropy = 1.0f; // 1 when samplerAnisotropy is not supported
     VkDevice _device = VK_NULL_HANDLE;
-    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
     
-    // TODO: pas fou
     PipelineHandle _currentPipeline;
-    ShaderHandle _currentVertexShader;
-    ShaderHandle _currentFragmentShader;
+    bool _pipelineValid = false; // the current pipeline was built, draws are skipped otherwise
+    ProgramHandle _currentProgram;
+    Bindings _currentBindings;
+    bool _graphicsWritesPending = false; // draws writing storage resources since the last dispatch
+    bool _computeWritesPending = false; // dispatches writing storage resources since the last barrier
+    DescriptorAllocatorVK _descriptorAllocators[MAX_FRAMES_IN_FLIGHT]; // reset once the frame is over
+    RasterState _rasterState; // raster state of the current pipeline with per draw overrides
+    bool _rasterStateDirty = false;
+    VkPipeline _boundPipeline = VK_NULL_HANDLE;
+    VkExtent2D _passExtent = {}; // viewport of the current pass
 
     SwapChainVK _swapChain;
     CommandQueueVK _cmdQueue;
+    LayoutCacheVK _layoutCache;
+    BindlessHeapVK _bindlessHeap;
+    VkPipelineLayout _bindlessBoundLayouts[2] = {}; // per bind point, layout the heap was bound with, null once disturbed
+    PipelineCacheVK _pipelineCache;
     PassVK _defaultPass;
     ShaderVK _shaders[MAX_SHADERS];
     ProgramVK _programs[MAX_PROGRAMS];
@@ -193,6 +423,13 @@ namespace jgfx::vk {
     BufferVK _buffers[MAX_BUFFERS];
     UniformBufferVK _uniformBuffers[MAX_BUFFERS];
     ImageVK _images[MAX_IMAGES];
-    uint32_t _currentUniformBufferId;
+    SamplerVK _samplers[MAX_SAMPLERS];
+    SamplerVK _defaultSampler; // used by image slots without sampler
+    BufferVK _uniformRings[MAX_FRAMES_IN_FLIGHT]; // applyUniforms data, one per frame in flight, grown when a frame needs more
+    uint32_t _uniformRingOffset = 0; // first free byte in the ring of the current frame
+    uint32_t _uniformOffset = 0; // dynamic offset of the latest applyUniforms data
+    uint32_t _uniformSize = 0; // 0 until the first applyUniforms
+    uint32_t _uniformDefaultRange = UNIFORM_BUFFER_SIZE; // descriptor range before the first applyUniforms
+    uint32_t _uniformAlignment = 256; // minUniformBufferOffsetAlignment
   };
 }
\ No newline at end of file
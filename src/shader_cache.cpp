@@ -0,0 +1,80 @@
+#include "shader_cache.h"
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <stdio.h>
+#include <thread>
+
+namespace jgfx {
+  void ShaderCache::init(const char* directory) {
+    if (directory == nullptr)
+      return;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+      return; // cache stays disabled
+
+    _directory = directory;
+  }
+
+  bool ShaderCache::isEnabled() const {
+    return !_directory.empty();
+  }
+
+  bool ShaderCache::load(uint64_t key, const char* extension, std::vector<uint8_t>& data) const {
+    if (!isEnabled())
+      return false;
+
+    std::ifstream file(getPath(key, extension), std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+      return false;
+
+    size_t size = (size_t)file.tellg();
+    data.resize(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), size);
+
+    return file.good();
+  }
+
+  bool ShaderCache::store(uint64_t key, const char* extension, const void* data, size_t size) const {
+    if (!isEnabled())
+      return false;
+
+    // write a temporary file first so that an entry is never read partially written
+    // the name is unique per call, identical entries can be stored from several threads at once
+    static std::atomic<uint32_t> tmpCounter{ 0 };
+    char tmpSuffix[48];
+    snprintf(tmpSuffix, sizeof(tmpSuffix), ".%zx.%u.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()), tmpCounter++);
+    std::filesystem::path path = getPath(key, extension);
+    std::filesystem::path tmpPath = path;
+    tmpPath += tmpSuffix;
+
+    {
+      std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+      if (!file.is_open())
+        return false;
+
+      file.write(reinterpret_cast<const char*>(data), size);
+      if (!file.good())
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, path, error);
+    if (error) {
+      std::filesystem::remove(tmpPath, error);
+      return false;
+    }
+
+    return true;
+  }
+
+  std::filesystem::path ShaderCache::getPath(uint64_t key, const char* extension) const {
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.%s", static_cast<unsigned long long>(key), extension);
+    return _directory / fileName;
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <vector>
+
+namespace jgfx {
+  /// <summary>
+  /// Content addressed on disk cache.
+  /// Each entry is a file named after its key, disabled when no directory is given
+  /// </summary>
+  struct ShaderCache {
+    void init(const char* directory);
+    bool isEnabled() const;
+    bool load(uint64_t key, const char* extension, std::vector<uint8_t>& data) const;
+    bool store(uint64_t key, const char* extension, const void* data, size_t size) const;
+    std::filesystem::path getPath(uint64_t key, const char* extension) const;
+
+    std::filesystem::path _directory;
+  };
+}
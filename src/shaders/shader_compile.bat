@@ -0,0 +1,2 @@
+"%VULKAN_SDK%/Bin/glslc.exe" cull.comp -mfmt=c -o cull.comp.inl
+pause
\ No newline at end of file
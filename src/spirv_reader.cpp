@@ -16,4 +16,50 @@ namespace jgfx {
 		// Compile to GLSL, ready to give to GL driver.
 		return glsl.compile();
   }
+
+  static void addBindings(const spirv_cross::Compiler& compiler, const spirv_cross::SmallVector<spirv_cross::Resource>& resources, ShaderResourceType type, ShaderReflection& reflection) {
+    for (const spirv_cross::Resource& resource : resources) {
+      const spirv_cross::SPIRType& spirType = compiler.get_type(resource.type_id);
+
+      ShaderBinding binding;
+      binding.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+      binding.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+      binding.type = type;
+      binding.count = spirType.array.empty() ? 1 : spirType.array[0];
+      if (type == ShaderResourceType::STORAGE_BUFFER)
+        binding.writable = !compiler.get_buffer_block_flags(resource.id).get(spv::DecorationNonWritable);
+      else if (type == ShaderResourceType::STORAGE_IMAGE)
+        binding.writable = !compiler.has_decoration(resource.id, spv::DecorationNonWritable);
+      reflection.bindings.push_back(binding);
+    }
+  }
+
+  ShaderReflection reflect(const void* binData, uint32_t size) {
+    spirv_cross::Compiler compiler(reinterpret_cast<const uint32_t*>(binData), size / 4);
+    spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+    ShaderReflection reflection;
+    addBindings(compiler, resources.uniform_buffers, ShaderResourceType::UNIFORM_BUFFER, reflection);
+    addBindings(compiler, resources.storage_buffers, ShaderResourceType::STORAGE_BUFFER, reflection);
+    addBindings(compiler, resources.sampled_images, ShaderResourceType::SAMPLED_IMAGE, reflection);
+    addBindings(compiler, resources.separate_images, ShaderResourceType::SEPARATE_IMAGE, reflection);
+    addBindings(compiler, resources.separate_samplers, ShaderResourceType::SEPARATE_SAMPLER, reflection);
+    addBindings(compiler, resources.storage_images, ShaderResourceType::STORAGE_IMAGE, reflection);
+
+    for (const spirv_cross::Resource& resource : resources.push_constant_buffers) {
+      const spirv_cross::SPIRType& spirType = compiler.get_type(resource.base_type_id);
+      reflection.pushConstantSize = static_cast<uint32_t>(compiler.get_declared_struct_size(spirType));
+    }
+
+    for (const spirv_cross::Resource& resource : resources.stage_inputs) {
+      const spirv_cross::SPIRType& spirType = compiler.get_type(resource.type_id);
+
+      ShaderInput input;
+      input.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
+      input.componentCount = spirType.vecsize;
+      reflection.inputs.push_back(input);
+    }
+
+    return reflection;
+  }
 }
\ No newline at end of file
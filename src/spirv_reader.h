@@ -2,7 +2,40 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace jgfx {
+  enum class ShaderResourceType {
+    UNIFORM_BUFFER,
+    STORAGE_BUFFER,
+    SAMPLED_IMAGE, // combined image and sampler
+    SEPARATE_IMAGE,
+    SEPARATE_SAMPLER,
+    STORAGE_IMAGE,
+  };
+
+  struct ShaderBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    ShaderResourceType type = ShaderResourceType::UNIFORM_BUFFER;
+    uint32_t count = 1; // array size, 0 for runtime sized arrays
+    bool writable = false; // storage buffer or image not declared readonly
+  };
+
+  struct ShaderInput {
+    uint32_t location = 0;
+    uint32_t componentCount = 0;
+  };
+
+  /// <summary>
+  /// Resources used by a SPIR-V shader
+  /// </summary>
+  struct ShaderReflection {
+    std::vector<ShaderBinding> bindings;
+    std::vector<ShaderInput> inputs; // stage inputs
+    uint32_t pushConstantSize = 0;
+  };
+
   std::string read(const void* binData, uint32_t size);
+  ShaderReflection reflect(const void* binData, uint32_t size);
 }
\ No newline at end of file
@@ -15,6 +15,18 @@ namespace jgfx::vk {
     }
   };
 
+  // Optional device features detected at initialization
+  struct DeviceFeaturesVK {
+    uint32_t apiVersion = VK_API_VERSION_1_0; // device api version
+    bool extendedDynamicState = false; // cull mode, front face and primitive topology are dynamic states
+    bool multiDrawIndirect = false; // indirect draws with a draw count greater than 1
+    bool drawIndirectCount = false; // draw count read from a buffer
+    bool synchronization2 = false; // barriers recorded with vkCmdPipelineBarrier2
+    bool timelineSemaphore = false; // submissions signal increasing values, fences otherwise
+    bool presentWait = false; // waits for the presentation of an image, only queried in low latency mode
+    bool descriptorIndexing = false; // bindless heap, only queried when requested
+  };
+
   struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
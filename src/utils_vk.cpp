@@ -1,6 +1,7 @@
 #include "utils_vk.h"
 
 #include "jgfx/jgfx.h"
+#include "spirv_reader.h"
 
 #include <algorithm>
 #include <set>
@@ -76,13 +77,14 @@ namespace jgfx::vk::utils {
     return availableFormats[0];
   }
 
-  VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+  VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR presentMode) {
     for (const auto& availablePresentMode : availablePresentModes) {
-      if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+      if (availablePresentMode == presentMode) {
         return availablePresentMode;
       }
     }
 
+    // the only mode required by the spec
     return VK_PRESENT_MODE_FIFO_KHR;
   }
 
@@ -185,10 +187,252 @@ namespace jgfx::vk::utils {
     case FLOAT2: return VK_FORMAT_R32G32_SFLOAT;
     case FLOAT3: return VK_FORMAT_R32G32B32_SFLOAT;
     case FLOAT4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case HALF2: return VK_FORMAT_R16G16_SFLOAT;
+    case HALF4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case BYTE4_NORM: return VK_FORMAT_R8G8B8A8_SNORM;
+    case UBYTE4_NORM: return VK_FORMAT_R8G8B8A8_UNORM;
+    case SHORT2_NORM: return VK_FORMAT_R16G16_SNORM;
+    case SHORT4_NORM: return VK_FORMAT_R16G16B16A16_SNORM;
+    case USHORT2_NORM: return VK_FORMAT_R16G16_UNORM;
+    case USHORT4_NORM: return VK_FORMAT_R16G16B16A16_UNORM;
+    case INT_10_10_10_2_NORM: return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+    case UINT_10_10_10_2_NORM: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    case UBYTE4: return VK_FORMAT_R8G8B8A8_UINT;
+    case INT: return VK_FORMAT_R32_SINT;
+    case INT2: return VK_FORMAT_R32G32_SINT;
+    case INT3: return VK_FORMAT_R32G32B32_SINT;
+    case INT4: return VK_FORMAT_R32G32B32A32_SINT;
+    case UINT: return VK_FORMAT_R32_UINT;
+    case UINT2: return VK_FORMAT_R32G32_UINT;
+    case UINT3: return VK_FORMAT_R32G32B32_UINT;
+    case UINT4: return VK_FORMAT_R32G32B32A32_UINT;
     }
     return VK_FORMAT_UNDEFINED;
   }
 
+  VkVertexInputRate toVkVertexInputRate(VertexStepRate stepRate) {
+    switch (stepRate) {
+    case VertexStepRate::PER_VERTEX: return VK_VERTEX_INPUT_RATE_VERTEX;
+    case VertexStepRate::PER_INSTANCE: return VK_VERTEX_INPUT_RATE_INSTANCE;
+    }
+    return VK_VERTEX_INPUT_RATE_VERTEX;
+  }
+
+  VkFormat toVkFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8_SRGB: return VK_FORMAT_R8G8B8A8_SRGB;
+    case TextureFormat::RGBA8: return VK_FORMAT_R8G8B8A8_UNORM;
+    case TextureFormat::RGBA16F: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case TextureFormat::RGBA32F: return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case TextureFormat::R32F: return VK_FORMAT_R32_SFLOAT;
+    case TextureFormat::D32F: return VK_FORMAT_D32_SFLOAT;
+    case TextureFormat::D24S8: return VK_FORMAT_D24_UNORM_S8_UINT; // see findDepthStencilFormat
+    }
+    return VK_FORMAT_R8G8B8A8_SRGB;
+  }
+
+  VkIndexType toVkIndexType(IndexType type) {
+    switch (type) {
+    case IndexType::UINT16: return VK_INDEX_TYPE_UINT16;
+    case IndexType::UINT32: return VK_INDEX_TYPE_UINT32;
+    }
+    return VK_INDEX_TYPE_UINT16;
+  }
+
+  uint32_t getTexelSize(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8_SRGB: return 4;
+    case TextureFormat::RGBA8: return 4;
+    case TextureFormat::RGBA16F: return 8;
+    case TextureFormat::RGBA32F: return 16;
+    case TextureFormat::R32F: return 4;
+    case TextureFormat::D32F: return 4;
+    case TextureFormat::D24S8: return 4;
+    }
+    return 4;
+  }
+
+  bool isDepthFormat(TextureFormat format) {
+    return format == TextureFormat::D32F || format == TextureFormat::D24S8;
+  }
+
+  VkImageAspectFlags getAspectMask(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D32_SFLOAT: return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D24_UNORM_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D32_SFLOAT_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default: return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+  }
+
+  bool hasStencil(VkFormat format) {
+    return (getAspectMask(format) & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+  }
+
+  VkSampleCountFlagBits toVkSampleCount(uint32_t samples) {
+    switch (samples) {
+    case 2: return VK_SAMPLE_COUNT_2_BIT;
+    case 4: return VK_SAMPLE_COUNT_4_BIT;
+    case 8: return VK_SAMPLE_COUNT_8_BIT;
+    case 16: return VK_SAMPLE_COUNT_16_BIT;
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+  }
+
+  VkAttachmentLoadOp toVkAttachmentLoadOp(LoadOp op) {
+    switch (op) {
+    case LoadOp::CLEAR: return VK_ATTACHMENT_LOAD_OP_CLEAR;
+    case LoadOp::LOAD: return VK_ATTACHMENT_LOAD_OP_LOAD;
+    case LoadOp::DONT_CARE: return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    }
+    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+  }
+
+  VkAttachmentStoreOp toVkAttachmentStoreOp(StoreOp op) {
+    switch (op) {
+    case StoreOp::STORE: return VK_ATTACHMENT_STORE_OP_STORE;
+    case StoreOp::DONT_CARE: return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+    return VK_ATTACHMENT_STORE_OP_STORE;
+  }
+
+  VkCompareOp toVkCompareOp(CompareFunc func) {
+    switch (func) {
+    case CompareFunc::NEVER: return VK_COMPARE_OP_NEVER;
+    case CompareFunc::LESS: return VK_COMPARE_OP_LESS;
+    case CompareFunc::EQUAL: return VK_COMPARE_OP_EQUAL;
+    case CompareFunc::LESS_EQUAL: return VK_COMPARE_OP_LESS_OR_EQUAL;
+    case CompareFunc::GREATER: return VK_COMPARE_OP_GREATER;
+    case CompareFunc::NOT_EQUAL: return VK_COMPARE_OP_NOT_EQUAL;
+    case CompareFunc::GREATER_EQUAL: return VK_COMPARE_OP_GREATER_OR_EQUAL;
+    case CompareFunc::ALWAYS: return VK_COMPARE_OP_ALWAYS;
+    }
+    return VK_COMPARE_OP_ALWAYS;
+  }
+
+  VkStencilOp toVkStencilOp(StencilOp op) {
+    switch (op) {
+    case StencilOp::KEEP: return VK_STENCIL_OP_KEEP;
+    case StencilOp::ZERO: return VK_STENCIL_OP_ZERO;
+    case StencilOp::REPLACE: return VK_STENCIL_OP_REPLACE;
+    case StencilOp::INCR_CLAMP: return VK_STENCIL_OP_INCREMENT_AND_CLAMP;
+    case StencilOp::DECR_CLAMP: return VK_STENCIL_OP_DECREMENT_AND_CLAMP;
+    case StencilOp::INVERT: return VK_STENCIL_OP_INVERT;
+    case StencilOp::INCR_WRAP: return VK_STENCIL_OP_INCREMENT_AND_WRAP;
+    case StencilOp::DECR_WRAP: return VK_STENCIL_OP_DECREMENT_AND_WRAP;
+    }
+    return VK_STENCIL_OP_KEEP;
+  }
+
+  VkColorComponentFlags toVkColorComponentFlags(uint8_t colorWriteMask) {
+    // same bit order as VkColorComponentFlagBits
+    return colorWriteMask & (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT);
+  }
+
+  VkFormat findDepthFormat(VkPhysicalDevice physicalDevice) {
+    // the spec guarantees depth attachment support for D16 and one of the other two
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+    for (VkFormat format : candidates) {
+      VkFormatProperties properties;
+      vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+      if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        return format;
+    }
+    return VK_FORMAT_D16_UNORM;
+  }
+
+  VkFormat findDepthStencilFormat(VkPhysicalDevice physicalDevice) {
+    // the spec guarantees depth attachment support for one of the two, D24 is missing on AMD
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D24_UNORM_S8_UINT, &properties);
+    if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+      return VK_FORMAT_D24_UNORM_S8_UINT;
+    return VK_FORMAT_D32_SFLOAT_S8_UINT;
+  }
+
+  void getLayoutSync(VkImageLayout layout, VkPipelineStageFlags2& stages, VkAccessFlags2& access) {
+    // stages and accesses using an image in this layout, on both sides of a transition
+    switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      stages = VK_PIPELINE_STAGE_2_NONE;
+      access = VK_ACCESS_2_NONE;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      stages = VK_PIPELINE_STAGE_2_COPY_BIT;
+      access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_GENERAL:
+      // storage images
+      stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+      break;
+    default:
+      stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+      access = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+      break;
+    }
+  }
+
+  void getResourceStateSync(ResourceState state, VkPipelineStageFlags2& stages, VkAccessFlags2& access) {
+    // stages and accesses of a resource in this state, on both sides of a barrier
+    switch (state) {
+    case ResourceState::UNDEFINED:
+      stages = VK_PIPELINE_STAGE_2_NONE;
+      access = VK_ACCESS_2_NONE;
+      break;
+    case ResourceState::SHADER_READ:
+      stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT
+        | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+      break;
+    case ResourceState::SHADER_WRITE:
+      stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      access = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+      break;
+    case ResourceState::COLOR_ATTACHMENT:
+      stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+      access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+      break;
+    case ResourceState::DEPTH_ATTACHMENT:
+      stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+      access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      break;
+    }
+  }
+
+  VkPipelineStageFlags toVkPipelineStageFlags(VkPipelineStageFlags2 stages) {
+    // the lower 32 bits match the legacy flags, finer grained stages fall back to the legacy stage containing them
+    VkPipelineStageFlags flags = static_cast<VkPipelineStageFlags>(stages & 0xFFFFFFFFull);
+    if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT))
+      flags |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT))
+      flags |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    return flags;
+  }
+
+  VkAccessFlags toVkAccessFlags(VkAccessFlags2 access) {
+    VkAccessFlags flags = static_cast<VkAccessFlags>(access & 0xFFFFFFFFull);
+    if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+      flags |= VK_ACCESS_SHADER_READ_BIT;
+    if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+      flags |= VK_ACCESS_SHADER_WRITE_BIT;
+    return flags;
+  }
+
+  VkPresentModeKHR toVkPresentMode(PresentMode mode) {
+    switch (mode) {
+    case PresentMode::FIFO: return VK_PRESENT_MODE_FIFO_KHR;
+    case PresentMode::MAILBOX: return VK_PRESENT_MODE_MAILBOX_KHR;
+    case PresentMode::IMMEDIATE: return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+
   VkCullModeFlagBits toVkCullModeFlagBits(CullMode mode) {
     switch (mode)
     {
@@ -218,4 +462,43 @@ namespace jgfx::vk::utils {
     }
     return VK_FRONT_FACE_CLOCKWISE;
   }
+
+  VkShaderStageFlagBits toVkShaderStage(ShaderType type) {
+    switch (type) {
+    case ShaderType::VERTEX: return VK_SHADER_STAGE_VERTEX_BIT;
+    case ShaderType::FRAGMENT: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case ShaderType::COMPUTE: return VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    return VK_SHADER_STAGE_VERTEX_BIT;
+  }
+
+  VkDescriptorType toVkDescriptorType(ShaderResourceType type) {
+    switch (type) {
+    case ShaderResourceType::UNIFORM_BUFFER: return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case ShaderResourceType::STORAGE_BUFFER: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    case ShaderResourceType::SAMPLED_IMAGE: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case ShaderResourceType::SEPARATE_IMAGE: return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    case ShaderResourceType::SEPARATE_SAMPLER: return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case ShaderResourceType::STORAGE_IMAGE: return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  }
+
+  VkFilter toVkFilter(Filter filter) {
+    return filter == Filter::NEAREST ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+  }
+
+  VkSamplerMipmapMode toVkSamplerMipmapMode(Filter filter) {
+    return filter == Filter::NEAREST ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  }
+
+  VkSamplerAddressMode toVkSamplerAddressMode(AddressMode mode) {
+    switch (mode) {
+    case AddressMode::REPEAT: return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    case AddressMode::MIRRORED_REPEAT: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    case AddressMode::CLAMP_TO_EDGE: return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    case AddressMode::CLAMP_TO_BORDER: return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    }
+    return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  }
 }
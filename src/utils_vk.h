@@ -9,13 +9,25 @@ namespace jgfx {
   enum CullMode;
   enum PrimitiveType;
   enum FaceWinding;
+  enum class ShaderType;
+  enum class ShaderResourceType;
+  enum class VertexStepRate;
+  enum class TextureFormat;
+  enum class IndexType;
+  enum class LoadOp;
+  enum class StoreOp;
+  enum class CompareFunc;
+  enum class StencilOp;
+  enum class PresentMode;
+  enum class Filter;
+  enum class AddressMode;
 }
 
 namespace jgfx::vk::utils {
   bool checkValidationLayerSupport(const std::vector<const char*>& validationLayers);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-  VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+  VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR presentMode);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, const Resolution& resolution);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& requiredExtensions);
@@ -25,7 +37,32 @@ namespace jgfx::vk::utils {
 
   // toVk conversions
   VkFormat toVkFormat(AttribType type);
+  VkVertexInputRate toVkVertexInputRate(VertexStepRate stepRate);
+  VkFormat toVkFormat(TextureFormat format);
+  VkIndexType toVkIndexType(IndexType type);
+  uint32_t getTexelSize(TextureFormat format);
+  bool isDepthFormat(TextureFormat format);
+  VkImageAspectFlags getAspectMask(VkFormat format);
+  bool hasStencil(VkFormat format);
+  VkSampleCountFlagBits toVkSampleCount(uint32_t samples);
+  VkAttachmentLoadOp toVkAttachmentLoadOp(LoadOp op);
+  VkAttachmentStoreOp toVkAttachmentStoreOp(StoreOp op);
+  VkCompareOp toVkCompareOp(CompareFunc func);
+  VkStencilOp toVkStencilOp(StencilOp op);
+  VkColorComponentFlags toVkColorComponentFlags(uint8_t colorWriteMask);
+  VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
+  VkFormat findDepthStencilFormat(VkPhysicalDevice physicalDevice);
+  void getLayoutSync(VkImageLayout layout, VkPipelineStageFlags2& stages, VkAccessFlags2& access);
+  void getResourceStateSync(ResourceState state, VkPipelineStageFlags2& stages, VkAccessFlags2& access);
+  VkPipelineStageFlags toVkPipelineStageFlags(VkPipelineStageFlags2 stages);
+  VkAccessFlags toVkAccessFlags(VkAccessFlags2 access);
+  VkPresentModeKHR toVkPresentMode(PresentMode mode);
   VkCullModeFlagBits toVkCullModeFlagBits(CullMode mode);
   VkPrimitiveTopology toVkPrimitiveTopology(PrimitiveType type);
   VkFrontFace toVkFrontFace(FaceWinding faceWinding);
+  VkShaderStageFlagBits toVkShaderStage(ShaderType type);
+  VkDescriptorType toVkDescriptorType(ShaderResourceType type);
+  VkFilter toVkFilter(Filter filter);
+  VkSamplerMipmapMode toVkSamplerMipmapMode(Filter filter);
+  VkSamplerAddressMode toVkSamplerAddressMode(AddressMode mode);
 }
\ No newline at end of file